@@ -44,6 +44,9 @@ void usage()
     std::cerr << "    --fov <fov> : set camera field of view to <fov>, in degrees. Only has effect for perspective projection. Default: 45 degrees" << std::endl;
     std::cerr << "    --repair : if present, repair and save files without bringing up gui;" << std::endl;
     std::cerr << "               currently only re-label duplicated points" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "unsaved changes are journaled in <filename>.journal; if label-points exits without" << std::endl;
+    std::cerr << "saving or discarding them, e.g. crashes, they are recovered from the journal next time" << std::endl;
     std::cerr << comma::csv::options::usage() << std::endl;
     std::cerr << std::endl;
     std::cerr << "<fields>" << std::endl;
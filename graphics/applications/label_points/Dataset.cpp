@@ -20,22 +20,224 @@
 #define BOOST_FILESYSTEM_VERSION 3
 #endif
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <comma/csv/ascii.h>
+#include <comma/csv/binary.h>
 #include <comma/csv/stream.h>
 #include "./Dataset.h"
 #include "./Tools.h"
 #include <snark/graphics/exception.h>
+#include <snark/graphics/impl/fast_ascii.h>
+#include <snark/graphics/impl/mapped_file.h>
+#include <snark/graphics/impl/parallel.h>
+#ifdef WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace snark { namespace graphics { namespace View {
 
-BasicDataset::BasicDataset() : m_visible( true ) {}
+namespace {
 
-BasicDataset::BasicDataset( const Eigen::Vector3d& offset ) : m_visible( true ), m_offset( offset ) {}
+bool flushToDisk( const std::string& filename ) // flush file to disk, since closing it only flushes it to the os
+{
+#ifdef WIN32
+    int fd = ::_open( filename.c_str(), _O_RDWR | _O_BINARY );
+    if( fd < 0 ) { return false; }
+    bool ok = ::_commit( fd ) == 0;
+    ::_close( fd );
+#else
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd < 0 ) { return false; }
+    bool ok = ::fsync( fd ) == 0;
+    ::close( fd );
+#endif
+    return ok;
+}
 
-const BasicDataset::Points& BasicDataset::points() const { return m_points; }
+const comma::uint32 noSlot = std::numeric_limits< comma::uint32 >::max();
+
+std::string idFields( const std::string& fields ) // quick and dirty: fields with everything but id blanked, to put only id into records
+{
+    std::vector< std::string > v = comma::split( fields, ',' );
+    for( std::size_t i = 0; i < v.size(); ++i ) { if( v[i] != "id" ) { v[i] = ""; } }
+    return comma::join( v, ',' );
+}
+
+struct Labelled // record still in partition
+{
+    const RecordStore* records;
+    comma::uint32 id;
+    bool operator()( comma::uint32 index ) const { return records->id( index ) == id; }
+};
 
-const BasicDataset::Partitions& BasicDataset::partitions() const { return m_partitions; }
+struct Sizes { std::size_t records; std::size_t bytes; }; // of a chunk of a memory-mapped file as it goes into a record store
+
+struct CountChunk // count records of one chunk, so that all the chunks can be parsed straight into the record store
+{
+    const std::vector< mapped_file::chunk >* chunks;
+    std::vector< Sizes >* sizes;
+    const comma::csv::options* options;
+
+    void operator()( std::size_t i ) const
+    {
+        const char* begin = ( *chunks )[i].first;
+        const char* end = ( *chunks )[i].second;
+        Sizes& s = ( *sizes )[i];
+        if( options->binary() ) { s.records = ( end - begin ) / options->format().size(); s.bytes = s.records * options->format().size(); return; }
+        s.records = 0;
+        s.bytes = 0;
+        for( mapped_file::chunk line; mapped_file::next_line( begin, end, line ); ++s.records ) { s.bytes += line.second - line.first; }
+    }
+};
+
+struct ParseChunk // parse one chunk of a memory-mapped file into its place in the record store and points
+{
+    const std::vector< mapped_file::chunk >* chunks;
+    const std::vector< Sizes >* offsets; // of each chunk in the record store
+    RecordStore* records;
+    std::vector< Eigen::Vector3d >* points;
+    std::vector< graphics::extents< Eigen::Vector3d > >* extents; // of each chunk
+    const comma::csv::options* options;
+
+    void operator()( std::size_t i ) const
+    {
+        const char* begin = ( *chunks )[i].first;
+        const char* end = ( *chunks )[i].second;
+        std::size_t index = ( *offsets )[i].records;
+        std::size_t offset = ( *offsets )[i].bytes;
+        graphics::extents< Eigen::Vector3d >& e = ( *extents )[i];
+        PointWithId sample;
+        sample.id = 0;
+        if( options->binary() )
+        {
+            comma::csv::binary< PointWithId > binary( options->format().string(), options->fields, false );
+            std::size_t size = options->format().size();
+            for( ; begin + size <= end; begin += size, ++index, offset += size )
+            {
+                PointWithId p = sample;
+                binary.get( p, begin );
+                records->set( index, p.id, begin, size, offset );
+                ( *points )[ index ] = p.point;
+                e.add( p.point );
+            }
+            return;
+        }
+        fast_ascii fast( options->fields, "x,y,z,id", options->delimiter );
+        comma::csv::ascii< PointWithId > ascii( options->fields, options->delimiter, false );
+        for( mapped_file::chunk line; mapped_file::next_line( begin, end, line ); ++index, offset += line.second - line.first )
+        {
+            PointWithId p = sample;
+            if( fast.covers() ) // plain numbers, no need for csv visiting
+            {
+                double values[4] = { 0, 0, 0, 0 };
+                fast.get( line.first, line.second, values );
+                p.point = Eigen::Vector3d( values[0], values[1], values[2] );
+                p.id = comma::uint32( values[3] );
+            }
+            else
+            {
+                ascii.get( p, std::string( line.first, line.second ) );
+            }
+            records->set( index, p.id, line.first, line.second - line.first, offset );
+            ( *points )[ index ] = p.point;
+            e.add( p.point );
+        }
+    }
+};
+
+struct FormatChunk // format one chunk of records for saving; records not relabelled are written as they were loaded
+{
+    const RecordStore* records;
+    const std::vector< bool >* dirty;
+    const comma::csv::options* options;
+    const std::string* fields;
+    std::size_t begin;
+    std::size_t size;
+    std::vector< std::string >* buffers;
+
+    static PointWithId point( comma::uint32 id ) { PointWithId p; p.id = id; return p; } // only id gets put
+
+    void operator()( std::size_t i ) const
+    {
+        std::size_t b = begin + i * size;
+        std::size_t e = std::min( b + size, records->size() );
+        std::string& buffer = ( *buffers )[i];
+        buffer.clear();
+        if( options->binary() )
+        {
+            comma::csv::binary< PointWithId > binary( options->format().string(), *fields, false );
+            std::size_t recordSize = options->format().size();
+            buffer.assign( records->record( b ), ( e - b ) * recordSize ); // binary records are contiguous
+            for( std::size_t j = b; j < e; ++j )
+            {
+                if( ( *dirty )[j] ) { binary.put( point( records->id( j ) ), &buffer[ ( j - b ) * recordSize ] ); }
+            }
+            return;
+        }
+        comma::csv::ascii< PointWithId > ascii( *fields, options->delimiter, false );
+        for( std::size_t j = b; j < e; ++j )
+        {
+            if( ( *dirty )[j] )
+            {
+                std::vector< std::string > v = comma::split( std::string( records->record( j ), records->recordSize( j ) ), options->delimiter );
+                ascii.put( point( records->id( j ) ), v );
+                buffer += comma::join( v, options->delimiter );
+            }
+            else
+            {
+                buffer.append( records->record( j ), records->recordSize( j ) );
+            }
+            buffer += '\n';
+        }
+    }
+};
+
+} // namespace {
+
+RecordStore::RecordStore( std::size_t size ) : m_size( size ) { if( m_size == 0 ) { m_offsets.push_back( 0 ); } }
+
+void RecordStore::add( comma::uint32 id, const char* record, std::size_t size )
+{
+    m_ids.push_back( id );
+    m_arena.insert( m_arena.end(), record, record + size );
+    if( m_size == 0 ) { m_offsets.push_back( m_arena.size() ); }
+}
+
+void RecordStore::reserve( std::size_t records, std::size_t bytes )
+{
+    m_ids.reserve( records );
+    m_arena.reserve( bytes );
+    if( m_size == 0 ) { m_offsets.reserve( records + 1 ); }
+}
+
+void RecordStore::resize( std::size_t records, std::size_t bytes )
+{
+    m_ids.resize( records );
+    m_arena.resize( bytes );
+    if( m_size == 0 ) { m_offsets.resize( records + 1, m_offsets.back() ); }
+}
+
+void RecordStore::set( std::size_t i, comma::uint32 id, const char* record, std::size_t size, std::size_t offset )
+{
+    m_ids[i] = id;
+    std::memcpy( &m_arena[ offset ], record, size );
+    if( m_size == 0 ) { m_offsets[ i + 1 ] = offset + size; }
+}
+
+BasicDataset::BasicDataset() : m_visible( true ), m_points( &m_xyz ) {}
+
+BasicDataset::BasicDataset( const Eigen::Vector3d& offset ) : m_visible( true ), m_points( &m_xyz ), m_offset( offset ) {}
+
+const BasicDataset::Points& BasicDataset::points() const { return m_points; }
 
 const Eigen::Vector3d& BasicDataset::offset() const { return *m_offset; }
 
@@ -48,23 +250,36 @@ const snark::graphics::extents< Eigen::Vector3d >& BasicDataset::extents() const
 void BasicDataset::clear()
 {
     m_points.clear();
-    m_partitions.clear();
+    std::vector< Eigen::Vector3d >().swap( m_xyz );
     m_vertices.reset();
+    m_slots.clear();
     m_extents = snark::graphics::extents< Eigen::Vector3d >();
 }
 
-void BasicDataset::init()
+void BasicDataset::init( const RecordStore& records )
 {
     m_vertices.reset();
+    m_slots.clear();
     if( m_points.empty() ) { return; }
     m_vertices.reset( new qt3d::vertex_buffer( m_points.size() ) );
-    for( Points::ConstEnumerator en = m_points.begin(); !en.end(); ++en )
-    {
-        Eigen::Vector3d pointXYZ =  en.key() - *m_offset;
-        QVector3D point( pointXYZ.x(), pointXYZ.y(), pointXYZ.z() );
-        QColor4ub color = Tools::colorFromId( en.value().id );
-        m_vertices->addVertex( point, color );
-    }
+    for( std::size_t i = 0; i < m_points.size(); ++i ) { addVertex( m_points.value( i ), records.id( m_points.value( i ) ) ); }
+}
+
+void BasicDataset::addVertex( comma::uint32 index, comma::uint32 id )
+{
+    if( index >= m_slots.size() ) { m_slots.resize( index + 1, noSlot ); }
+    Eigen::Vector3d pointXYZ =  m_xyz[ index ] - *m_offset;
+    QVector3D point( pointXYZ.x(), pointXYZ.y(), pointXYZ.z() );
+    m_vertices->addVertex( point, Tools::colorFromId( id ) );
+    m_slots[ index ] = m_vertices->last();
+}
+
+void BasicDataset::setColor( comma::uint32 index, comma::uint32 id )
+{
+    if( !m_vertices || index >= m_slots.size() || m_slots[ index ] == noSlot ) { return; }
+    comma::uint32 slot = m_slots[ index ];
+    m_vertices->setColor( slot, Tools::colorFromId( id ) );
+    m_vertices->markDirty( slot, slot + 1 );
 }
 
 void BasicDataset::draw( QGLPainter* painter ) const
@@ -73,51 +288,33 @@ void BasicDataset::draw( QGLPainter* painter ) const
     {
         painter->setStandardEffect(QGL::FlatPerVertexColor);
         painter->clearAttributes();
-        painter->setVertexAttribute(QGL::Position, m_vertices->points() );
-        painter->setVertexAttribute(QGL::Color, m_vertices->color() );
-        painter->draw( QGL::Points, m_vertices->size(), m_vertices->index() );
+        m_vertices->bind( painter );
+        std::vector< qt3d::vertex_buffer::interval > visible = m_vertices->visible( painter );
+        for( std::size_t i = 0; i < visible.size(); ++i ) { painter->draw( QGL::Points, visible[i].second - visible[i].first, visible[i].first ); }
+        m_vertices->release( painter );
     }
 }
 
-void BasicDataset::insert( const Eigen::Vector3d& p, const BasicDataset::Data& data )
+void BasicDataset::drawPick( QGLPainter* painter, qt3d::pick_buffer& pick, comma::uint32 base ) const
 {
-    m_points.insert( p, data );
-    m_partitions[ data.id ].insert( p, data );
+    if( m_visible && m_vertices ) { pick.draw( painter, *m_vertices, base ); }
 }
 
-void BasicDataset::insert( const BasicDataset::Points& m ) // quick and dirty
+void BasicDataset::insert( const Eigen::Vector3d& p )
 {
-    if( m.empty() ) { return; }
-    m_points.insert( m );
-    for( Points::ConstEnumerator en = m.begin(); !en.end(); ++en )
-    {
-        m_partitions[ en.value().id ].insert( en.key(), en.value() );
-        m_extents.add( en.key() ); // quick and dirty: erase will screw it, but no other way...
-    }
-    init();
+    m_points.insert( m_xyz.size() );
+    m_xyz.push_back( p );
 }
 
-void BasicDataset::erase( const BasicDataset::Points& m ) // quick and dirty
-{
-    if( m.empty() ) { return; }
-    m_points.erase( m );
-    for( Points::ConstEnumerator en = m.begin(); !en.end(); ++en )
-    {
-        Partitions::iterator it = m_partitions.find( en.value().id );
-        if( it == m_partitions.end() ) { continue; }
-        it->second.erase( en.key() );
-        if( it->second.empty() ) { m_partitions.erase( it ); }
-    }
-    init();
-} 
-
-Dataset::Dataset( const std::string& filename, const comma::csv::options& options, bool relabelDuplicated )
+Dataset::Dataset( const std::string& filename, const comma::csv::options& options, bool relabelDuplicated, bool writable )
     : m_filename( filename )
     , m_options( options )
-    , m_writable( true )
+    , m_writable( writable )
     , m_modified( false )
+    , m_patchable( true )
+    , m_selectionVersion( 0 )
+    , m_journal( filename + ".journal" )
 {
-    backup();
     load();
     if( relabelDuplicated ) { labelDuplicated(); init(); }
 }
@@ -125,125 +322,262 @@ Dataset::Dataset( const std::string& filename, const comma::csv::options& option
 Dataset::Dataset( const std::string& filename
                 , const comma::csv::options& options
                 , const Eigen::Vector3d& offset
-                , bool relabelDuplicated )
+                , bool relabelDuplicated
+                , bool writable )
     : m_filename( filename )
     , m_options( options )
-    , m_writable( true )
+    , m_writable( writable )
     , m_modified( false )
+    , m_patchable( true )
+    , m_selectionVersion( 0 )
+    , m_journal( filename + ".journal" )
 {
     m_offset = offset;
-    backup();
     load();
     if( relabelDuplicated ) { labelDuplicated(); init(); }
 }
 
-void Dataset::backup()
-{
-    static const std::string tilda = m_filename + "~";
-    if( boost::filesystem::exists( tilda ) ) { boost::filesystem::remove( tilda ); }
-    boost::filesystem::copy_file( m_filename, tilda );
-}
-
 void Dataset::save()
 {
     if( !m_modified ) { std::cerr << "label-points: no changes since last save in " << m_filename << std::endl; return; }
-    std::ofstream ofs( m_filename.c_str(), m_options.binary() ? std::ios::binary | std::ios::out : std::ios::out );
-    if( !ofs.good() ) { std::cerr << "label-points: error: failed to open " << m_filename << std::endl; return; }
-    std::vector< std::string > v = comma::split( m_options.fields, ',' ); // quick and dirty
-    for( std::size_t i = 0; i < v.size(); ++i ) { if( v[i] != "id" ) { v[i] = ""; } }
-    std::string fields = comma::join( v, ',' );
-    boost::scoped_ptr< comma::csv::ascii_output_stream< PointWithId > > ascii;
-    boost::scoped_ptr< comma::csv::binary_output_stream< PointWithId > > binary;
-    if( m_options.binary() ) { binary.reset( new comma::csv::binary_output_stream< PointWithId >( ofs, m_options.format().string(), fields, false ) ); }
-    else { ascii.reset( new comma::csv::ascii_output_stream< PointWithId >( ofs, fields, m_options.delimiter, false ) ); }
-    std::size_t count = 0;
-    for( std::size_t i = 0; i < m_deque.size(); ++i )
+    if( patch() ) { commit(); m_journal.truncate(); return; }
+    const std::string temporary = m_filename + ".tmp"; // write a copy and replace the file with it only once the copy is on disk, thus a failure or crash never leaves a truncated file
+    std::ofstream ofs( temporary.c_str(), m_options.binary() ? std::ios::binary | std::ios::out : std::ios::out );
+    if( !ofs.good() ) { std::cerr << "label-points: error: failed to open " << temporary << std::endl; return; }
+    const std::string fields = idFields( m_options.fields );
+    static const std::size_t size = 65536; // records per chunk
+    std::vector< std::string > buffers( parallel_threads() );
+    FormatChunk format = { &m_records, &m_dirty, &m_options, &fields, 0, size, &buffers };
+    for( ; format.begin < m_records.size(); format.begin += buffers.size() * size ) // format chunks in parallel, write them in order, a few at a time to keep memory bounded
     {
-        if( m_options.binary() ) { binary->write( m_deque[i].first, m_deque[i].second.c_str() ); }
-        else { ascii->write( m_deque[i].first, m_deque[i].second ); }
-        if( ++count % 10000 == 0 ) { std::cerr << "\rlabel-points: saved " << count << " lines to " << m_filename << "             "; }
+        std::size_t n = std::min( buffers.size(), ( m_records.size() - format.begin + size - 1 ) / size );
+        parallel_for( n, format );
+        for( std::size_t i = 0; i < n; ++i ) { ofs.write( buffers[i].data(), buffers[i].size() ); }
+        std::cerr << "\rlabel-points: saved " << std::min( format.begin + n * size, m_records.size() ) << " lines to " << m_filename << "             ";
     }
+    ofs.close();
+    if( ofs.fail() || !flushToDisk( temporary ) ) { std::cerr << std::endl << "label-points: error: failed to write " << temporary << "; " << m_filename << " not changed" << std::endl; boost::filesystem::remove( temporary ); return; }
+    try { boost::filesystem::rename( temporary, m_filename ); }
+    catch( std::exception& ex ) { std::cerr << std::endl << "label-points: error: failed to replace " << m_filename << " with " << temporary << ": " << ex.what() << std::endl; return; }
+    m_patchable = true;
     commit();
-    std::cerr << "\rlabel-points: saved " << count << " lines to " << m_filename << "             " << std::endl;
+    m_journal.truncate();
+    std::cerr << "\rlabel-points: saved " << m_records.size() << " lines to " << m_filename << "             " << std::endl;
+}
+
+bool Dataset::patch() // quick and dirty: overwrite ids of relabelled records in binary file, if it still has the records loaded
+{
+    if( !m_options.binary() || !m_patchable || !mapped_file::mappable( m_filename ) ) { return false; }
+    try
+    {
+        std::size_t size = m_options.format().size();
+        mapped_file file( m_filename, true );
+        if( file.size() / size != m_records.size() ) { return false; }
+        comma::csv::binary< PointWithId > binary( m_options.format().string(), idFields( m_options.fields ), false );
+        std::size_t count = 0;
+        for( std::size_t i = 0; i < m_dirty.size(); ++i )
+        {
+            if( !m_dirty[i] ) { continue; }
+            binary.put( FormatChunk::point( m_records.id( i ) ), file.writable_data() + i * size );
+            ++count;
+        }
+        file.flush();
+        std::cerr << "label-points: patched " << count << " record(s) in place in " << m_filename << std::endl;
+        return true;
+    }
+    catch( std::exception& ex ) { std::cerr << "label-points: failed to patch " << m_filename << " in place: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "label-points: failed to patch " << m_filename << " in place: unknown exception" << std::endl; }
+    return false;
 }
 
 void Dataset::saveAs( const std::string& f )
 {
     std::cerr << "label-points: saving " << m_filename << " as " << f << "..." << std::endl;
+    std::string journal = m_journal.filename();
     m_filename = f;
+    m_journal.filename( f + ".journal" );
     m_modified = true;
+    m_patchable = false;
     save();
+    if( !m_modified && boost::filesystem::exists( journal ) ) { boost::filesystem::remove( journal ); } // unsaved changes of the old file are in the new file now
 }
 
 bool Dataset::valid() const { return m_valid; }
 
 void Dataset::load()
 {
-    m_deque.clear();
-    m_selection.reset();
+    m_records = RecordStore( m_options.binary() ? m_options.format().size() : 0 );
+    m_partitions.clear();
+    m_stale.clear();
+    m_selection = Selection();
+    m_drawnWords.clear();
+    m_drawnIndices.clear();
+    std::vector< comma::uint32 >().swap( m_drawnPositions ); // gets allocated for the new number of records on first selection
+    m_selectionSlots.resize( 0 );
     this->BasicDataset::clear();
-    std::ifstream ifs( m_filename.c_str(), m_options.binary() ? std::ios::binary | std::ios::in : std::ios::in );
-    if( !ifs.good() ) { COMMA_THROW( graphics::exception, "failed to open \"" << m_filename << "\"" ); }
-    boost::scoped_ptr< comma::csv::ascii_input_stream< PointWithId > > ascii;
-    boost::scoped_ptr< comma::csv::binary_input_stream< PointWithId > > binary;
-    if( m_options.binary() ) { binary.reset( new comma::csv::binary_input_stream< PointWithId >( ifs, m_options.format().string(), m_options.fields, false ) ); }
-    else { ascii.reset( new comma::csv::ascii_input_stream< PointWithId >( ifs, m_options.fields, m_options.delimiter, false ) ); }
-    std::size_t count = 0;
     try
     {
-        bool first = true;
-        while( true )
-        {
-            const PointWithId* p = m_options.binary() ? binary->read() : ascii->read();
-            if( p == NULL ) { break; }
-            if( first && !m_offset ) { m_offset = p->point.x() > 1000 || p->point.y() > 1000 || p->point.z() > 1000 ? p->point : Eigen::Vector3d(); first = false; }
-            BasicDataset::insert( p->point, Data( p->id, m_deque.size() ) );
-            if( m_options.binary() )
-            {
-                m_deque.push_back( std::make_pair( *p, std::string( binary->last(), m_options.format().size() ) ) );
-            }
-            else
-            {
-                m_deque.push_back( std::make_pair( *p, comma::join( ascii->last(), m_options.delimiter ) ) );
-            }
-            m_extents.add( p->point );
-            if( ++count % 10000 == 0 ) { std::cerr << "\rlabel-points: loaded " << count << " lines from " << m_filename << "             "; }
-        }
-        m_selection.reset( new BasicDataset( *m_offset ) );
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+        if( mapped_file::mappable( m_filename ) ) { loadMapped(); }
+        else { loadStream(); }
+        m_points.index(); // build spatial index now rather than on the first click
+        if( !m_offset ) { m_offset = Eigen::Vector3d( 0, 0, 0 ); }
+        m_selection = Selection( m_records.size() );
         commit();
-        std::cerr << "\rlabel-points: loaded " << count << " lines from " << m_filename << "             " << std::endl;
+        if( m_writable ) { recover(); }
+        double seconds = ( boost::posix_time::microsec_clock::universal_time() - start ).total_milliseconds() / 1000.;
+        std::cerr << "\rlabel-points: loaded " << m_records.size() << " lines from " << m_filename << " in " << seconds << " s";
+        if( seconds > 0 ) { std::cerr << " (" << std::size_t( m_records.size() / seconds ) << " lines/s)"; }
+        std::cerr << "             " << std::endl;
         m_valid = true;
         return;
     }
     catch( std::exception& ex ) { std::cerr << "label-points: " << m_filename << ": " << ex.what() << std::endl; }
     catch( ... ) { std::cerr << "label-points: " << m_filename << ": unknown exception" << std::endl; }
+    m_dirty.assign( m_records.size(), false );
     m_valid = false;
 }
 
+void Dataset::loadMapped() // count records of chunks in parallel, then parse chunks in parallel straight into their places in file order
+{
+    mapped_file file( m_filename );
+    std::vector< mapped_file::chunk > chunks = m_options.binary() ? file.chunks( parallel_threads(), m_options.format().size() ) : file.lines( parallel_threads() );
+    std::vector< Sizes > offsets( chunks.size() );
+    CountChunk count = { &chunks, &offsets, &m_options };
+    parallel_for( chunks.size(), count );
+    comma::uint32 first = m_records.size();
+    Sizes size = { m_records.size(), m_records.bytes() };
+    for( std::size_t i = 0; i < offsets.size(); ++i ) { Sizes s = offsets[i]; offsets[i] = size; size.records += s.records; size.bytes += s.bytes; }
+    m_records.resize( size.records, size.bytes );
+    m_xyz.resize( size.records );
+    std::vector< graphics::extents< Eigen::Vector3d > > extents( chunks.size() );
+    ParseChunk parse = { &chunks, &offsets, &m_records, &m_xyz, &extents, &m_options };
+    parallel_for( chunks.size(), parse );
+    if( first == m_records.size() ) { return; }
+    if( !m_offset ) { setOffset( m_xyz[ first ] ); }
+    for( std::size_t i = 0; i < extents.size(); ++i ) { if( extents[i].size() > 0 ) { m_extents.add( extents[i] ); } }
+    for( comma::uint32 i = first; i < m_records.size(); ++i ) { m_partitions[ m_records.id( i ) ].insert( i ); }
+    m_points.insert( first, m_records.size() );
+}
+
+void Dataset::loadStream()
+{
+    std::ifstream ifs( m_filename.c_str(), m_options.binary() ? std::ios::binary | std::ios::in : std::ios::in );
+    if( !ifs.good() ) { COMMA_THROW( graphics::exception, "failed to open \"" << m_filename << "\"" ); }
+    boost::scoped_ptr< comma::csv::ascii_input_stream< PointWithId > > ascii;
+    boost::scoped_ptr< comma::csv::binary_input_stream< PointWithId > > binary;
+    if( m_options.binary() ) { binary.reset( new comma::csv::binary_input_stream< PointWithId >( ifs, m_options.format().string(), m_options.fields, false ) ); }
+    else { ascii.reset( new comma::csv::ascii_input_stream< PointWithId >( ifs, m_options.fields, m_options.delimiter, false ) ); }
+    while( true )
+    {
+        const PointWithId* p = m_options.binary() ? binary->read() : ascii->read();
+        if( p == NULL ) { break; }
+        if( m_options.binary() ) { loadRecord( *p, binary->last(), m_options.format().size() ); continue; }
+        std::string line = comma::join( ascii->last(), m_options.delimiter );
+        loadRecord( *p, line.data(), line.size() );
+    }
+}
+
+void Dataset::setOffset( const Eigen::Vector3d& first ) { m_offset = first.x() > 1000 || first.y() > 1000 || first.z() > 1000 ? first : Eigen::Vector3d( 0, 0, 0 ); }
+
+void Dataset::loadRecord( const PointWithId& p, const char* record, std::size_t size )
+{
+    if( !m_offset ) { setOffset( p.point ); }
+    BasicDataset::insert( p.point );
+    m_partitions[ p.id ].insert( comma::uint32( m_records.size() ) ); // indices come in ascending order
+    m_records.add( p.id, record, size );
+    m_extents.add( p.point );
+    if( m_records.size() % 10000 == 0 ) { std::cerr << "\rlabel-points: loaded " << m_records.size() << " lines from " << m_filename << "             "; }
+}
+
 std::size_t Dataset::labelimpl( const Eigen::Vector3d& p, comma::uint32 id )
 {
     if( !m_writable ) { return 0; }
-    std::vector< Data* > d = m_points.find( p );
+    std::vector< comma::uint32 > indices = m_points.find( p );
+    std::size_t count = 0;
+    for( std::size_t i = 0; i < indices.size(); ++i ) { count += labelimpl( indices[i], id ); }
+    return count;
+}
+
+bool Dataset::labelimpl( comma::uint32 index, comma::uint32 id )
+{
+    if( m_records.id( index ) == id ) { return false; }
+    m_journal.add( index, m_records.id( index ), id );
+    return relabel( index, id );
+}
+
+bool Dataset::relabel( comma::uint32 index, comma::uint32 id )
+{
+    if( m_records.id( index ) == id ) { return false; }
+    m_stale.insert( m_records.id( index ) ); // index stays in the old partition until partitions() is called
+    m_partitions[ id ].insert( index );
+    m_stale.insert( id );
+    m_records.id( index, id );
+    m_dirty[ index ] = true;
+    setColor( index, id );
+    m_modified = true;
+    return true;
+}
+
+std::size_t Dataset::apply( const Journal::Runs& runs )
+{
     std::size_t count = 0;
-    for( std::size_t i = 0; i < d.size(); ++i )
+    for( std::size_t i = 0; i < runs.size(); ++i )
     {
-        if( d[i]->id == id ) { continue; }
-        ++count;
-        m_partitions[ d[i]->id ].erase( p );
-        d[i]->id = id;
-        m_partitions[ id ].insert( p, *d[i] );
-        m_deque[ d[i]->index ].first.id = id;
-        m_modified = true;
+        for( comma::uint32 j = runs[i].index; j < runs[i].index + runs[i].size; ++j ) { count += relabel( j, runs[i].to ); }
     }
     return count;
 }
 
+void Dataset::recover() // replay changes not saved in the last session, e.g. if label-points crashed
+{
+    if( !boost::filesystem::exists( m_journal.filename() ) ) { return; }
+    Journal::Runs runs = Journal::read( m_journal.filename() );
+    std::map< comma::uint32, comma::uint32 > ids; // ids as replayed so far, validate all runs before applying any
+    for( std::size_t i = 0; i < runs.size(); ++i )
+    {
+        bool valid = runs[i].index + comma::uint64( runs[i].size ) <= m_records.size();
+        for( comma::uint32 j = runs[i].index; valid && j < runs[i].index + runs[i].size; ++j )
+        {
+            std::map< comma::uint32, comma::uint32 >::iterator it = ids.find( j );
+            valid = ( it == ids.end() ? m_records.id( j ) : it->second ) == runs[i].from;
+            ids[j] = runs[i].to;
+        }
+        if( valid ) { continue; }
+        std::cerr << "label-points: warning: journal " << m_journal.filename() << " does not match " << m_filename << " as saved; ignored" << std::endl;
+        return;
+    }
+    std::size_t count = apply( runs );
+    if( count == 0 ) { return; }
+    std::cerr << "label-points: recovered unsaved changes in " << m_filename << " by replaying " << count << " change(s) from " << m_journal.filename() << std::endl;
+}
+
+bool Dataset::finishStep() { return m_journal.finish(); }
+
+bool Dataset::undo()
+{
+    Journal::Runs runs;
+    if( !m_journal.undo( runs ) ) { return false; }
+    apply( runs );
+    return true;
+}
+
+bool Dataset::redo()
+{
+    Journal::Runs runs;
+    if( !m_journal.redo( runs ) ) { return false; }
+    apply( runs );
+    return true;
+}
+
+void Dataset::discard() { m_journal.truncate(); }
+
 void Dataset::labelDuplicated() // quick and dirty
 {
     if( !m_writable ) { std::cerr << "label-points: will not re-label duplicated points in read-only " << m_filename << "..." << std::endl; return; }
     std::cerr << "label-points: re-labelling duplicated points in " << m_filename << "..." << std::endl;
     std::size_t count = 0;
-    for( Points::ConstEnumerator en = m_points.begin(); !en.end(); ++en )    { count += labelimpl( en.key(), en.value().id ); }
+    for( std::size_t i = 0; i < m_points.size(); ++i ) { count += labelimpl( m_points.key( i ), m_records.id( m_points.value( i ) ) ); } // duplicates get the id of the first of them
     //init();
     std::cerr << "label-points: re-labelled " << count << " duplicated point(s)" << std::endl;
 }
@@ -251,19 +585,110 @@ void Dataset::labelDuplicated() // quick and dirty
 void Dataset::label( const Eigen::Vector3d& p, comma::uint32 id )
 {
     labelimpl( p, id );
-    init(); // todo: hideous! remove, once the bug (something wrong with m_vertices->set) fixed
 }
 
-void Dataset::label( const BasicDataset::Points& m, comma::uint32 id )
+void Dataset::label( const std::vector< Eigen::Vector3d >& points, comma::uint32 id )
 {
     if( !m_writable ) { return; }
-    for( Points::ConstEnumerator en = m.begin(); !en.end(); ++en ) { labelimpl( en.key(), id ); }
-    init(); // todo: remove, once the bug (something wrong with m_vertices->set) fixed
+    for( std::size_t i = 0; i < points.size(); ++i ) { labelimpl( points[i], id ); }
+}
+
+void Dataset::label( const Selection& s, comma::uint32 id )
+{
+    if( !m_writable ) { return; }
+    std::vector< comma::uint32 > indices = s.indices();
+    for( std::size_t i = 0; i < indices.size(); ++i ) { labelimpl( indices[i], id ); }
+}
+
+std::vector< Eigen::Vector3d > Dataset::selectedPoints() const
+{
+    std::vector< comma::uint32 > indices = m_selection.indices();
+    std::vector< Eigen::Vector3d > points( indices.size() );
+    for( std::size_t i = 0; i < indices.size(); ++i ) { points[i] = m_xyz[ indices[i] ]; }
+    return points;
+}
+
+const Dataset::Partitions& Dataset::partitions() const
+{
+    for( std::set< comma::uint32 >::const_iterator it = m_stale.begin(); it != m_stale.end(); ++it )
+    {
+        Partitions::iterator p = m_partitions.find( *it );
+        if( p == m_partitions.end() ) { continue; }
+        Labelled labelled = { &m_records, *it };
+        p->second.normalise();
+        p->second.keep( labelled );
+        if( p->second.empty() ) { m_partitions.erase( p ); }
+    }
+    m_stale.clear();
+    return m_partitions;
 }
 
-BasicDataset& Dataset::selection() { return *m_selection; }
+comma::uint32 Dataset::id( comma::uint32 index ) const { return m_records.id( index ); }
 
-const BasicDataset& Dataset::selection() const { return *m_selection; }
+void Dataset::init()
+{
+    BasicDataset::init( m_records );
+    m_drawnWords.clear(); // vertex slots have changed
+}
+
+void Dataset::selectVertex( comma::uint32 index )
+{
+    if( m_drawnPositions.empty() ) { m_drawnPositions.resize( m_records.size() ); }
+    m_drawnPositions[ index ] = m_drawnIndices.size();
+    m_drawnIndices.push_back( index );
+    m_selectionSlots.append( m_slots[ index ] );
+}
+
+void Dataset::deselectVertex( comma::uint32 index ) // move the last selected vertex into the gap
+{
+    comma::uint32 position = m_drawnPositions[ index ];
+    comma::uint32 last = m_drawnIndices.back();
+    m_drawnIndices[ position ] = last;
+    m_selectionSlots[ position ] = m_selectionSlots.last();
+    m_drawnPositions[ last ] = position;
+    m_drawnIndices.pop_back();
+    m_selectionSlots.resize( m_selectionSlots.size() - 1 );
+}
+
+void Dataset::updateSelection() // compare selection with what is drawn 64 records at a time, touch only records in changed words
+{
+    if( m_drawnWords.empty() || m_selection.empty() )
+    {
+        m_drawnWords.assign( m_selection.words(), 0 );
+        m_drawnIndices.clear();
+        m_selectionSlots.resize( 0 );
+    }
+    for( std::size_t i = 0; i < m_drawnWords.size(); ++i )
+    {
+        comma::uint64 word = m_selection.word( i );
+        if( word == m_drawnWords[i] ) { continue; }
+        for( comma::uint64 changed = word ^ m_drawnWords[i], j = 0; changed != 0; changed >>= 1, ++j )
+        {
+            if( !( changed & 1 ) ) { continue; }
+            comma::uint32 index = comma::uint32( i * 64 + j );
+            if( word & ( comma::uint64( 1 ) << j ) ) { selectVertex( index ); } else { deselectVertex( index ); }
+        }
+        m_drawnWords[i] = word;
+    }
+    m_selectionIndices.setIndexes( m_selectionSlots );
+    m_selectionVersion = m_selection.version();
+}
+
+void Dataset::drawSelection( QGLPainter* painter ) // draw selected vertices of the dataset itself through an index buffer, thus colours are always up to date
+{
+    if( !m_vertices ) { return; }
+    if( m_drawnWords.empty() || m_selectionVersion != m_selection.version() ) { updateSelection(); }
+    if( m_selectionSlots.isEmpty() ) { return; }
+    painter->setStandardEffect( QGL::FlatPerVertexColor );
+    painter->clearAttributes();
+    m_vertices->bind( painter );
+    painter->draw( QGL::Points, m_selectionIndices );
+    m_vertices->release( painter );
+}
+
+Selection& Dataset::selection() { return m_selection; }
+
+const Selection& Dataset::selection() const { return m_selection; }
 
 const std::string& Dataset::filename() const { return m_filename; }
 
@@ -275,7 +700,11 @@ bool Dataset::writable() const { return m_writable; }
 
 bool Dataset::modified() const { return m_modified; }
 
-void Dataset::commit() { m_modified = false; }
+void Dataset::commit()
+{
+    m_modified = false;
+    m_dirty.assign( m_records.size(), false );
+}
 
 void Dataset::repair( const comma::csv::options& options ) // quick and dirty
 {
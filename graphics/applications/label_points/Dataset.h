@@ -19,92 +19,155 @@
 #ifndef SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_DATASET_H_
 #define SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_DATASET_H_
 
-#include <deque>
+#include <map>
+#include <set>
+#include <vector>
 #include <comma/base/types.h>
 #include <comma/csv/options.h>
 #include <snark/graphics/impl/extents.h>
 #include <snark/graphics/vector.h>
+#include <snark/graphics/qt3d/pick_buffer.h>
 #include <snark/graphics/qt3d/vertex_buffer.h>
+#include "./Journal.h"
 #include "./PointMap.h"
 #include "./PointWithId.h"
+#include "./Selection.h"
+#include <Qt3D/qglindexbuffer.h>
 #include <Qt3D/qglpainter.h>
 
 namespace snark { namespace graphics { namespace View {
 
+/// records of a file in file order: current ids and the records as loaded,
+/// the latter in one arena rather than in a string per record
+class RecordStore
+{
+    public:
+        /// @param size record size for binary records; 0 for lines of any size
+        RecordStore( std::size_t size = 0 );
+        void add( comma::uint32 id, const char* record, std::size_t size );
+        void reserve( std::size_t records, std::size_t bytes );
+
+        /// resize to given number of records and total bytes of records, e.g. to fill the store with set() in parallel
+        void resize( std::size_t records, std::size_t bytes );
+
+        /// set record i at given offset in bytes; records are to be set so that each starts where the previous one ends
+        void set( std::size_t i, comma::uint32 id, const char* record, std::size_t size, std::size_t offset );
+        std::size_t bytes() const { return m_arena.size(); }
+        std::size_t size() const { return m_ids.size(); }
+        comma::uint32 id( std::size_t i ) const { return m_ids[i]; }
+        void id( std::size_t i, comma::uint32 id ) { m_ids[i] = id; }
+        const char* record( std::size_t i ) const { return &m_arena[ m_size == 0 ? m_offsets[i] : i * m_size ]; }
+        std::size_t recordSize( std::size_t i ) const { return m_size == 0 ? std::size_t( m_offsets[ i + 1 ] - m_offsets[i] ) : m_size; }
+
+    private:
+        std::size_t m_size;
+        std::vector< comma::uint32 > m_ids;
+        std::vector< char > m_arena;
+        std::vector< comma::uint64 > m_offsets; // for lines only: begin of each line in arena and end of the last one
+};
+
 class BasicDataset
 {
     public:
-        struct Data
-        {
-            comma::uint32 id;
-            std::size_t index;
-            Data() {}
-            Data( const Data& rhs ) { operator=( rhs ); }
-            Data( comma::uint32 id, std::size_t index ) : id( id ), index( index ) {}
-        };
-        typedef PointMap< Eigen::Vector3d, Data > Points;
-        typedef std::map< comma::uint32, Points > Partitions;    
+        typedef PointMap< Eigen::Vector3d > Points; // record indices by point
         BasicDataset();
         BasicDataset( const Eigen::Vector3d& offset );
         const Points& points() const;
-        const Partitions& partitions() const;
         const Eigen::Vector3d& offset() const;
         const graphics::extents< Eigen::Vector3d >& extents() const;
-        void init();
         void draw( QGLPainter* painter ) const;
+
+        /// draw points for picking, numbered from base + 1 on in the order of points(), as vertices are added in init()
+        void drawPick( QGLPainter* painter, qt3d::pick_buffer& pick, comma::uint32 base ) const;
         void visible( bool visible );
         bool visible() const;
         void clear();
-        void insert( const Points& m );
-        void erase( const Points& m );
     
     protected:
         bool m_visible;
-        Points m_points;
-        Partitions m_partitions;
+        std::vector< Eigen::Vector3d > m_xyz; // points by record index
+        Points m_points; // over m_xyz
         boost::scoped_ptr< qt3d::vertex_buffer > m_vertices;
         boost::optional< Eigen::Vector3d > m_offset;
         graphics::extents< Eigen::Vector3d > m_extents;
-        void insert( const Eigen::Vector3d& p, const Data& data );
+        std::vector< comma::uint32 > m_slots; // vertex by record index, to update vertices without rebuilding the buffer
+        void init( const RecordStore& records ); // add vertices in the order of points(), coloured by id
+        void insert( const Eigen::Vector3d& p );
+        void addVertex( comma::uint32 index, comma::uint32 id );
+        void setColor( comma::uint32 index, comma::uint32 id );
 };
 
 class Dataset : public BasicDataset
 {
     public:
-        Dataset( const std::string& filename, const comma::csv::options& options, bool relabelDuplicated );
-        Dataset( const std::string& filename, const comma::csv::options& options, const Eigen::Vector3d& offset, bool relabelDuplicated );
+        /// @param writable if false, duplicated points do not get relabelled and unsaved changes do not get recovered
+        Dataset( const std::string& filename, const comma::csv::options& options, bool relabelDuplicated, bool writable = true );
+        Dataset( const std::string& filename, const comma::csv::options& options, const Eigen::Vector3d& offset, bool relabelDuplicated, bool writable = true );
+        typedef std::map< comma::uint32, Partition > Partitions; // record indices by id
+        const Partitions& partitions() const;
+        comma::uint32 id( comma::uint32 index ) const; // current id of record
+        void init();
+        void drawSelection( QGLPainter* painter );
         void save();
         void saveAs( const std::string& f );
         void load();
-        void backup();
         void label( const Eigen::Vector3d& p, comma::uint32 id );
-        void label( const Points& p, comma::uint32 id );
+        void label( const std::vector< Eigen::Vector3d >& points, comma::uint32 id );
+        void label( const Selection& s, comma::uint32 id );
+        std::vector< Eigen::Vector3d > selectedPoints() const;
         void writable( bool enabled );
         bool writable() const;
         bool modified() const;
         void commit();
-        BasicDataset& selection();
-        const BasicDataset& selection() const;
+
+        /// finish current edit step, e.g. after a click; return false, if nothing has been relabelled in the step
+        bool finishStep();
+        bool undo();
+        bool redo();
+
+        /// remove journal of unsaved changes, e.g. if changes get discarded on exit
+        void discard();
+        Selection& selection();
+        const Selection& selection() const;
         const std::string& filename() const;
         const comma::csv::options& options() const;
         bool valid() const;
         static void repair( const comma::csv::options& options );
     
     private:
-        void insert( const Points& m );
-        void erase( const Points& m );
         void clear();
         std::size_t labelimpl( const Eigen::Vector3d& p, comma::uint32 id );
+        bool labelimpl( comma::uint32 index, comma::uint32 id );
+        bool relabel( comma::uint32 index, comma::uint32 id );
+        std::size_t apply( const Journal::Runs& runs );
+        void recover();
         void labelDuplicated();
-        //typedef std::deque< std::pair< PointWithId, std::vector< std::string > > > Deque;
-        typedef std::deque< std::pair< PointWithId, std::string > > Deque;
-        Deque m_deque;
+        void updateSelection();
+        void selectVertex( comma::uint32 index );
+        void deselectVertex( comma::uint32 index );
+        void loadMapped();
+        void loadStream();
+        void loadRecord( const PointWithId& p, const char* record, std::size_t size );
+        void setOffset( const Eigen::Vector3d& first ); // offset from the first point loaded
+        bool patch();
+        RecordStore m_records;
         std::string m_filename;
         const comma::csv::options m_options;
-        boost::scoped_ptr< BasicDataset > m_selection;
+        mutable Partitions m_partitions;
+        mutable std::set< comma::uint32 > m_stale; // partitions with indices of relabelled records, cleaned up in partitions()
+        Selection m_selection;
+        std::vector< comma::uint64 > m_drawnWords; // selection words as of m_selectionSlots; empty, if the latter has to be rebuilt
+        std::vector< comma::uint32 > m_drawnIndices; // selected record indices, in the order of m_selectionSlots
+        std::vector< comma::uint32 > m_drawnPositions; // position in m_selectionSlots by record index, allocated on first selection
+        QArray< unsigned int > m_selectionSlots; // vertices of selected records in m_vertices
+        QGLIndexBuffer m_selectionIndices;
+        comma::uint64 m_selectionVersion;
         bool m_writable;
         bool m_modified;
         bool m_valid;
+        std::vector< bool > m_dirty; // records relabelled since the last save
+        bool m_patchable; // the file has records in the same order and format as m_records, thus binary ids can be overwritten in place
+        Journal m_journal; // relabelling history, unsaved part of it in a file next to the dataset
 };
 
 } } } // namespace snark { namespace graphics { namespace View {
@@ -0,0 +1,114 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <iostream>
+#include <boost/filesystem/operations.hpp>
+#include "./Journal.h"
+
+namespace snark { namespace graphics { namespace View {
+
+Journal::Journal( const std::string& filename ) : m_filename( filename ), m_done( 0 ) {}
+
+void Journal::add( comma::uint32 index, comma::uint32 from, comma::uint32 to )
+{
+    if( !m_current.empty() )
+    {
+        Run& last = m_current.back();
+        if( last.index + last.size == index && last.from == from && last.to == to ) { ++last.size; return; } // records of a partition are relabelled in ascending order
+    }
+    Run run = { index, 1, from, to };
+    m_current.push_back( run );
+}
+
+bool Journal::finish()
+{
+    if( m_current.empty() ) { return false; }
+    m_runs.resize( m_done == 0 ? 0 : m_steps[ m_done - 1 ] ); // new step drops undone steps
+    m_steps.resize( m_done );
+    m_runs.insert( m_runs.end(), m_current.begin(), m_current.end() );
+    m_steps.push_back( m_runs.size() );
+    ++m_done;
+    write( m_current );
+    m_current.clear();
+    return true;
+}
+
+bool Journal::undo( Journal::Runs& runs )
+{
+    finish();
+    if( m_done == 0 ) { return false; }
+    std::size_t begin = m_done == 1 ? 0 : m_steps[ m_done - 2 ];
+    runs.clear();
+    for( std::size_t i = m_steps[ m_done - 1 ]; i > begin; --i ) // backwards, in case a record was relabelled more than once in the step
+    {
+        Run run = m_runs[ i - 1 ];
+        std::swap( run.from, run.to );
+        runs.push_back( run );
+    }
+    --m_done;
+    write( runs );
+    return true;
+}
+
+bool Journal::redo( Journal::Runs& runs )
+{
+    finish();
+    if( m_done == m_steps.size() ) { return false; }
+    std::size_t begin = m_done == 0 ? 0 : m_steps[ m_done - 1 ];
+    runs.assign( m_runs.begin() + begin, m_runs.begin() + m_steps[ m_done ] );
+    ++m_done;
+    write( runs );
+    return true;
+}
+
+void Journal::truncate()
+{
+    if( m_filename.empty() || !boost::filesystem::exists( m_filename ) ) { return; }
+    boost::filesystem::remove( m_filename );
+}
+
+void Journal::write( const Journal::Runs& runs ) // step as number of runs followed by runs, flushed right away to survive a crash
+{
+    if( m_filename.empty() ) { return; }
+    std::ofstream ofs( m_filename.c_str(), std::ios::binary | std::ios::out | std::ios::app );
+    comma::uint32 size = runs.size();
+    ofs.write( reinterpret_cast< const char* >( &size ), sizeof( size ) );
+    ofs.write( reinterpret_cast< const char* >( &runs[0] ), runs.size() * sizeof( Run ) );
+    ofs.flush();
+    if( !ofs.good() ) { std::cerr << "label-points: warning: failed to write journal " << m_filename << std::endl; }
+}
+
+Journal::Runs Journal::read( const std::string& filename )
+{
+    Runs runs;
+    std::ifstream ifs( filename.c_str(), std::ios::binary | std::ios::in );
+    while( ifs.good() )
+    {
+        comma::uint32 size;
+        if( !ifs.read( reinterpret_cast< char* >( &size ), sizeof( size ) ) ) { break; }
+        Runs step;
+        Run run;
+        while( step.size() < size && ifs.read( reinterpret_cast< char* >( &run ), sizeof( run ) ) ) { step.push_back( run ); } // run by run, not to trust size of a garbled step
+        if( step.size() < size ) { break; }
+        runs.insert( runs.end(), step.begin(), step.end() );
+    }
+    return runs;
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
@@ -0,0 +1,81 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_JOURNAL_H_
+#define SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_JOURNAL_H_
+
+#include <string>
+#include <vector>
+#include <comma/base/types.h>
+
+namespace snark { namespace graphics { namespace View {
+
+/// relabelling history of a dataset for undo and redo, as runs of consecutive record indices
+/// relabelled from the same id to the same id; memory is proportional to the number of changes
+///
+/// each finished step is also appended to a journal file next to the dataset, undo and redo as their
+/// inverse or repeated step, thus replaying the file on top of the dataset as last saved recovers all
+/// unsaved changes, e.g. after a crash
+class Journal
+{
+    public:
+        struct Run
+        {
+            comma::uint32 index; // of first record
+            comma::uint32 size; // number of records
+            comma::uint32 from; // old id
+            comma::uint32 to; // new id
+        };
+        typedef std::vector< Run > Runs;
+
+        /// @param filename journal file; no file gets written, if empty
+        Journal( const std::string& filename = "" );
+
+        /// add relabelling of a record to the current step
+        void add( comma::uint32 index, comma::uint32 from, comma::uint32 to );
+
+        /// finish current step and append it to the file; return false, if nothing has changed in the step
+        bool finish();
+
+        /// get runs to apply to undo the last step, in the order to apply them; return false, if nothing to undo
+        bool undo( Runs& runs );
+
+        /// get runs to apply to redo the last undone step; return false, if nothing to redo
+        bool redo( Runs& runs );
+
+        /// remove journal file, e.g. once the dataset is saved; undo history is kept
+        void truncate();
+
+        const std::string& filename() const { return m_filename; }
+        void filename( const std::string& f ) { m_filename = f; }
+
+        /// return all runs in the journal file in the order to apply them; a partially written last step is ignored
+        static Runs read( const std::string& filename );
+
+    private:
+        std::string m_filename;
+        Runs m_runs; // runs of all steps
+        std::vector< std::size_t > m_steps; // end of each step in m_runs
+        std::size_t m_done; // number of steps not undone
+        Runs m_current;
+        void write( const Runs& runs );
+};
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif // SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_JOURNAL_H_
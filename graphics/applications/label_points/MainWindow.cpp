@@ -41,6 +41,12 @@ MainWindow::MainWindow( const std::string& title, Viewer* viewer )
     saveAction->setShortcuts( QKeySequence::Save );
     Actions::Action* saveAsAction = new Actions::Action( "SaveAs...", boost::bind( &MainWindow::saveAs, this ) );
     Actions::Action* reloadAction = new Actions::Action( "Reload", boost::bind( &Viewer::reload, viewer ) );
+    Actions::Action* undoAction = new Actions::Action( "Undo", boost::bind( &Viewer::undo, boost::ref( m_viewer ) ) );
+    undoAction->setIcon( QIcon::fromTheme( "edit-undo" ) );
+    undoAction->setShortcuts( QKeySequence::Undo );
+    Actions::Action* redoAction = new Actions::Action( "Redo", boost::bind( &Viewer::redo, boost::ref( m_viewer ) ) );
+    redoAction->setIcon( QIcon::fromTheme( "edit-redo" ) );
+    redoAction->setShortcuts( QKeySequence::Redo );
 
     Actions::ToggleAction* navigateSceneAction = new Actions::ToggleAction( QIcon::fromTheme("edit-select", Icons::pointer() ) , "navigate scene", boost::bind( &Tools::Navigate::toggle, boost::ref( viewer->navigate ), _1 ), "Ctrl+Q" );
     Actions::ToggleAction* selectPointsAction = new Actions::ToggleAction( QIcon::fromTheme("zoom-select", Icons::select()), "select points", boost::bind( &Tools::SelectClip::toggle, boost::ref( viewer->selectClip ), _1 ), "Ctrl+W" );
@@ -74,8 +80,14 @@ MainWindow::MainWindow( const std::string& title, Viewer* viewer )
     fileMenu->addAction( shakeColorsAction );
     menuBar()->addMenu( fileMenu );
 
+    QMenu* editMenu = menuBar()->addMenu( "Edit" );
+    editMenu->addAction( undoAction );
+    editMenu->addAction( redoAction );
+
     QToolBar* fileToolBar = addToolBar( "File" );
     fileToolBar->addAction( saveAction );
+    fileToolBar->addAction( undoAction );
+    fileToolBar->addAction( redoAction );
 
     m_fileFrame = new QFrame;
     m_fileFrame->setFrameStyle( QFrame::Plain | QFrame::NoFrame );
@@ -284,6 +296,7 @@ void MainWindow::closeEvent( QCloseEvent *event )
                     return;
 
                 case QMessageBox::DestructiveRole:
+                    m_viewer.dataset( i ).discard();
                     break;
             }
         }
@@ -304,6 +317,7 @@ void MainWindow::closeEvent( QCloseEvent *event )
                     return;
 
                 case QMessageBox::DestructiveRole:
+                    m_viewer.dataset( i ).discard();
                     break;
             }
         }
@@ -19,214 +19,338 @@
 #ifndef SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_POINTMAP_H_
 #define SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_POINTMAP_H_
 
-#include <map>
+#include <algorithm>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 #include <boost/optional.hpp>
-#include <boost/static_assert.hpp>
+#include <comma/base/types.h>
 #include <comma/math/compare.h>
 
 namespace snark {
 
 namespace impl {
 
-template< typename K, typename T, std::size_t D, typename Compare = std::less< T > >
-struct MultidimensionalMapimpl : public std::map< K, MultidimensionalMapimpl< K, T, D - 1, Compare >, Compare >
+template < typename T > struct Less { bool operator()( const T& s, const T& t ) const { return comma::math::less( s, t ); } };
+
+/// lexicographic order of points, coordinates compared as by comma::math::less
+template < typename P >
+struct LexicographicLess
 {
-    typedef MultidimensionalMapimpl< K, T, D - 1, Compare > BaseValueType;
-    typedef std::map< K, BaseValueType, Compare > Base;
-    
-    template < typename P >
-    std::vector< T* > find( const P& p )
+    bool operator()( const P& s, const P& t ) const
     {
-        typename Base::iterator it = this->Base::find( p[ p.size() - D ] );
-        if( it == this->Base::end() ) { return std::vector< T* >(); }
-        return it->second.find( p );
-    }    
+        for( int i = 0; i < s.size(); ++i )
+        {
+            if( comma::math::less( s[i], t[i] ) ) { return true; }
+            if( comma::math::less( t[i], s[i] ) ) { return false; }
+        }
+        return false;
+    }
+};
+
+} // namespace impl {
+
+/// spatial index of points kept elsewhere, e.g. in the xyz column of a dataset, by their 32-bit indices in it
+///
+/// an entry is a 64-bit morton key of the point and its index, in two arrays, i.e. 12 bytes per point;
+/// entries are sorted by key, then by point, then by index, thus equal points are adjacent in ascending order
+/// of their indices and entries close in the order are close in space; points are read from the column,
+/// which must outlive the map and must not change indexed points
+///
+/// insertions and erasures are batched and merged into the arrays on the next query,
+/// thus loading or editing many points costs one sort rather than a tree insertion per point;
+/// keys are computed within the extents of the points at the time; once inserted points are outside of them,
+/// keys of all the points get computed again
+///
+/// box queries go through bounding boxes of blocks of entries and of groups of them, built on the first box query
+/// after a change, so that a query only looks at blocks that overlap the box on all the axes
+template< typename P >
+class PointMap
+{
+    public:
+        typedef std::vector< P > Column;
+
+        /// @param column points by index
+        PointMap( const Column* column = NULL ) : m_column( column ) {}
+
+        /// add point with given index in the column
+        void insert( comma::uint32 index );
+
+        /// add points with indices in [begin, end), e.g. all the points just loaded into the column
+        void insert( comma::uint32 begin, comma::uint32 end );
+
+        /// remove point with given index in the column
+        void erase( comma::uint32 index );
+
+        /// return indices of points equal to p in ascending order
+        std::vector< comma::uint32 > find( const P& p ) const;
+
+        /// call f( point, index ) for each point in the box [lower, upper] in no particular order,
+        /// without copying anything; f must not change the map
+        template < typename F > void find( const P& lower, const P& upper, F& f ) const;
+
+        /// build box index now rather than on the first box query
+        void index() const;
 
-    template < typename P >
-    void erase( const P& p )
+        /// return point and its index of i-th entry in the order of entries; positions change with insertions and erasures
+        const P& key( std::size_t i ) const { flush(); return ( *m_column )[ m_indices[i] ]; }
+        comma::uint32 value( std::size_t i ) const { flush(); return m_indices[i]; }
+
+        std::size_t size() const { flush(); return m_indices.size(); }
+        bool empty() const { return size() == 0; }
+        void clear();
+
+        std::string toString() const; // quick and dirty; for testing
+
+    private:
+        struct Entry
+        {
+            comma::uint64 key;
+            comma::uint32 index;
+        };
+        struct Less // entries by key, point, index
+        {
+            const Column* column;
+            bool operator()( const Entry& a, const Entry& b ) const
+            {
+                if( a.key != b.key ) { return a.key < b.key; }
+                impl::LexicographicLess< P > less;
+                if( less( ( *column )[ a.index ], ( *column )[ b.index ] ) ) { return true; }
+                if( less( ( *column )[ b.index ], ( *column )[ a.index ] ) ) { return false; }
+                return a.index < b.index;
+            }
+        };
+        enum { block = 32, fanout = 16 }; // entries per block, boxes per box one level up
+        struct Box
+        {
+            P min;
+            P max;
+            Box() {}
+            Box( const P& p ) : min( p ), max( p ) {}
+            void add( const P& p ) { min = min.cwiseMin( p ); max = max.cwiseMax( p ); }
+            void add( const Box& b ) { add( b.min ); add( b.max ); }
+        };
+        void flush() const;
+        void rekey() const;
+        comma::uint64 key( const P& p ) const;
+        static bool overlaps( const Box& b, const P& lower, const P& upper );
+        static bool inside( const P& p, const P& lower, const P& upper );
+        template < typename F > void find( unsigned int level, std::size_t i, const P& lower, const P& upper, F& f ) const;
+        const Column* m_column;
+        mutable std::vector< comma::uint64 > m_keys; // sorted, see Less
+        mutable std::vector< comma::uint32 > m_indices; // index of point in column by entry
+        mutable std::vector< comma::uint32 > m_inserted; // not merged yet
+        mutable std::vector< comma::uint32 > m_erased; // not erased yet
+        mutable boost::optional< Box > m_extents; // keys are computed within them
+        mutable std::vector< std::vector< Box > > m_boxes; // bounding boxes of blocks, then of fanout boxes each, up to one box; empty, if not built
+};
+
+template< typename P >
+inline void PointMap< P >::clear()
+{
+    m_keys.clear();
+    m_indices.clear();
+    m_inserted.clear();
+    m_erased.clear();
+    m_extents.reset();
+    m_boxes.clear();
+}
+
+template< typename P >
+inline comma::uint64 PointMap< P >::key( const P& p ) const // interleave bits of coordinates quantised within extents
+{
+    const unsigned int bits = 63 / P::RowsAtCompileTime;
+    const double cells = ( comma::uint64( 1 ) << bits ) - 1;
+    comma::uint64 q[ P::RowsAtCompileTime ];
+    for( int k = 0; k < P::RowsAtCompileTime; ++k )
     {
-        typename Base::iterator it = this->Base::find( p[ p.size() - D ] );
-        if( it == this->Base::end() ) { return; }
-        it->second.erase( p );
-        if( it->second.empty() ) { this->Base::erase( it ); }
+        double size = m_extents->max[k] - m_extents->min[k];
+        q[k] = size > 0 ? comma::uint64( ( p[k] - m_extents->min[k] ) / size * cells ) : 0;
     }
+    comma::uint64 code = 0;
+    for( int b = bits - 1; b >= 0; --b ) { for( int k = 0; k < P::RowsAtCompileTime; ++k ) { code = ( code << 1 ) | ( ( q[k] >> b ) & 1 ); } }
+    return code;
+}
 
-    template < typename P >
-    void insert( const P& p, const T& t ) { this->Base::operator[]( p[ p.size() - D ] ).insert( p, t ); }
-    
-    template < typename P >
-    void find( MultidimensionalMapimpl& m, const P& lower, const P& upper ) const
+template< typename P >
+inline void PointMap< P >::rekey() const // extend extents to inserted points, compute keys of all the points again
+{
+    for( std::size_t i = 0; i < m_inserted.size(); ++i )
     {
-        typename Base::const_iterator i = this->Base::lower_bound( lower[ lower.size() - D ] );
-        typename Base::const_iterator j = this->Base::upper_bound( upper[ upper.size() - D ] );
-        for( ; i != j; ++i )
-        { 
-            i->second.find( m[ i->first ], lower, upper );
-            if( m[ i->first ].empty() ) { m.MultidimensionalMapimpl::Base::erase( i->first ); } // quick and dirty, fix later
-        }
+        const P& p = ( *m_column )[ m_inserted[i] ];
+        if( m_extents ) { m_extents->add( p ); } else { m_extents = Box( p ); }
     }
-    
-    std::size_t size() const
-    {
-        std::size_t s = 0;
-        for( typename Base::const_iterator i = this->Base::begin(); i != this->Base::end(); ++i ) { s += i->second.size(); }
-        return s;
-    }  
-    
-    struct Enumerator // too lame to be called iterator
+    m_inserted.insert( m_inserted.end(), m_indices.begin(), m_indices.end() );
+    std::vector< comma::uint64 >().swap( m_keys );
+    std::vector< comma::uint32 >().swap( m_indices );
+}
+
+template< typename P >
+inline void PointMap< P >::flush() const // a nasty hack violating constness
+{
+    if( !m_erased.empty() || !m_inserted.empty() ) { m_boxes.clear(); }
+    if( !m_erased.empty() )
     {
-        void operator++()
+        std::sort( m_erased.begin(), m_erased.end() );
+        std::size_t size = 0;
+        for( std::size_t i = 0; i < m_indices.size(); ++i )
         {
-            if( it == map->end() ) { return; }
-            if( en.it != en.map->end() ) { ++en; if( en.it != en.map->end() ) { return; } }
-            ++it;
-            if( it == map->end() ) { return; }
-            it->second.setBegin( en );
+            if( std::binary_search( m_erased.begin(), m_erased.end(), m_indices[i] ) ) { continue; }
+            m_keys[ size ] = m_keys[i];
+            m_indices[ size ] = m_indices[i];
+            ++size;
         }
-        template < typename P >
-        void get( P& key, T*& value )
-        {
-            if( it == map->end() ) { value = NULL; return; }
-            key[ key.size() - D ] = it->first;
-            en.get( key, value );
-        }
-        typename Base::iterator it;
-        typename BaseValueType::Enumerator en;
-        MultidimensionalMapimpl* map;
-    };
-    
-    void setBegin( Enumerator& e )
-    { 
-        e.map = const_cast< MultidimensionalMapimpl* >( this );
-        e.it = e.map->Base::begin();
-        if( e.it != this->Base::end() ) { e.it->second.setBegin( e.en ); }
+        m_keys.resize( size );
+        m_indices.resize( size );
+        m_erased.clear();
     }
-    
-    void toString( std::ostringstream& oss, const std::string& indent = "" ) const
+    if( m_inserted.empty() ) { return; }
+    for( std::size_t i = 0; i < m_inserted.size(); ++i )
     {
-        oss << indent << "[" << D << "]: size = " << this->Base::size() << ":" << std::endl;
-        for( typename Base::const_iterator it = this->Base::begin(); it != this->Base::end(); ++it )
-        {
-            oss << indent << "    " << it->first << ":" << std::endl;
-            it->second.toString( oss, indent + "        " );
-        }
-    }    
-};
+        if( !m_extents || !inside( ( *m_column )[ m_inserted[i] ], m_extents->min, m_extents->max ) ) { rekey(); break; }
+    }
+    Less less = { m_column };
+    std::vector< Entry > inserted( m_inserted.size() );
+    for( std::size_t i = 0; i < m_inserted.size(); ++i ) { inserted[i].key = key( ( *m_column )[ m_inserted[i] ] ); inserted[i].index = m_inserted[i]; }
+    std::vector< comma::uint32 >().swap( m_inserted );
+    std::sort( inserted.begin(), inserted.end(), less );
+    std::vector< comma::uint64 > keys( m_keys.size() + inserted.size() );
+    std::vector< comma::uint32 > indices( keys.size() );
+    std::size_t i = 0;
+    std::size_t j = 0;
+    for( std::size_t k = 0; k < keys.size(); ++k ) // merge
+    {
+        Entry e = { i < m_keys.size() ? m_keys[i] : 0, i < m_indices.size() ? m_indices[i] : 0 };
+        bool existing = j == inserted.size() || ( i < m_keys.size() && !less( inserted[j], e ) );
+        if( existing ) { keys[k] = m_keys[i]; indices[k] = m_indices[i]; ++i; }
+        else { keys[k] = inserted[j].key; indices[k] = inserted[j].index; ++j; }
+    }
+    m_keys.swap( keys );
+    m_indices.swap( indices );
+}
 
-template< typename K, typename T, typename Compare >
-struct MultidimensionalMapimpl< K, T, 1, Compare > : public std::multimap< K, T, Compare > // public std::multimap< K, T, Compare >
+template< typename P >
+inline std::vector< comma::uint32 > PointMap< P >::find( const P& p ) const
 {
-    typedef std::multimap< K, T, Compare > Base; // typedef std::multimap< K, T, Compare > Base;
-
-    template < typename P >
-    std::vector< T* > find( const P& p )
+    flush();
+    std::vector< comma::uint32 > v;
+    if( m_indices.empty() || !inside( p, m_extents->min, m_extents->max ) ) { return v; }
+    comma::uint64 k = key( p );
+    impl::LexicographicLess< P > less;
+    for( std::size_t i = std::lower_bound( m_keys.begin(), m_keys.end(), k ) - m_keys.begin(); i < m_keys.size() && m_keys[i] == k; ++i )
     {
-        std::vector< T* > v;
-        typename Base::iterator it = this->Base::lower_bound( p[ p.size() - 1 ] );
-        typename Base::iterator upper = this->Base::upper_bound( p[ p.size() - 1 ] );
-        for( ; it != this->Base::end() && it != upper; ++it ) { v.push_back( &it->second ); }
-        return v;
+        const P& q = ( *m_column )[ m_indices[i] ];
+        if( !less( p, q ) && !less( q, p ) ) { v.push_back( m_indices[i] ); }
     }
-    
-    template < typename P >
-    void erase( const P& p ) { this->Base::erase( p[ p.size() - 1 ] ); }
+    return v;
+}
+
+template< typename P >
+inline void PointMap< P >::insert( comma::uint32 index )
+{
+    if( !m_erased.empty() ) { flush(); } // keep the order of erasures and insertions
+    m_inserted.push_back( index );
+}
+
+template< typename P >
+inline void PointMap< P >::insert( comma::uint32 begin, comma::uint32 end )
+{
+    if( !m_erased.empty() ) { flush(); }
+    m_inserted.reserve( m_inserted.size() + ( end - begin ) );
+    for( comma::uint32 i = begin; i < end; ++i ) { m_inserted.push_back( i ); }
+}
 
-    template < typename P >
-    void insert( const P& p, const T& t ) { this->Base::insert( std::make_pair( p[ p.size() - 1 ], t ) ); }
+template< typename P >
+inline void PointMap< P >::erase( comma::uint32 index )
+{
+    if( !m_inserted.empty() ) { flush(); }
+    m_erased.push_back( index );
+}
 
-    template < typename P >
-    void find( MultidimensionalMapimpl& m, const P& lower, const P& upper ) const
+template< typename P >
+inline void PointMap< P >::index() const
+{
+    flush();
+    if( !m_boxes.empty() || m_indices.empty() ) { return; }
+    m_boxes.assign( 1, std::vector< Box >() );
+    m_boxes[0].reserve( ( m_indices.size() + block - 1 ) / block );
+    for( std::size_t i = 0; i < m_indices.size(); ++i )
     {
-        if( comma::math::less( upper[ lower.size() - 1 ], lower[ lower.size() - 1 ] ) ) { return; }
-        typename Base::const_iterator l = this->Base::lower_bound( lower[ lower.size() - 1 ] );
-        typename Base::const_iterator u = this->Base::upper_bound( upper[ upper.size() - 1 ] );
-        if( l == this->Base::end() && u == this->Base::end() ) { return; }
-        m.Base::insert( l, u );
+        const P& p = ( *m_column )[ m_indices[i] ];
+        if( i % block == 0 ) { m_boxes[0].push_back( Box( p ) ); }
+        else { m_boxes[0].back().add( p ); }
     }
-    
-    struct Enumerator // too lame to be called iterator
-    {
-        void operator++() { if( it != map->end() ) { ++it; } }
-        template < typename P >
-        void get( P& key, T*& value )
-        {
-            if( it == map->end() ) { value = NULL; return; }
-            key[ key.size() - 1 ] = it->first;
-            value = &it->second;
-        }
-        typename Base::iterator it;
-        MultidimensionalMapimpl* map;
-    };
-    
-    void setBegin( Enumerator& e ) { e.map = const_cast< MultidimensionalMapimpl* >( this ); e.it = e.map->Base::begin(); }
-    
-    void toString( std::ostringstream& oss, const std::string& indent ) const
+    while( m_boxes.back().size() > 1 )
     {
-        for( typename Base::const_iterator it = this->Base::begin(); it != this->Base::end(); ++it )
+        const std::vector< Box >& below = m_boxes.back();
+        std::vector< Box > boxes;
+        for( std::size_t i = 0; i < below.size(); ++i )
         {
-            oss << indent << it->first << ":" << it->second << std::endl;
+            if( i % fanout == 0 ) { boxes.push_back( below[i] ); }
+            else { boxes.back().add( below[i] ); }
         }
+        m_boxes.push_back( boxes );
     }
-};
+}
 
-template < typename T > struct Less { bool operator()( const T& s, const T& t ) const { return comma::math::less( s, t ); } };
+template< typename P >
+inline bool PointMap< P >::overlaps( const Box& b, const P& lower, const P& upper )
+{
+    for( int i = 0; i < lower.size(); ++i ) { if( comma::math::less( b.max[i], lower[i] ) || comma::math::less( upper[i], b.min[i] ) ) { return false; } }
+    return true;
+}
 
-} // namespace impl {
+template< typename P >
+inline bool PointMap< P >::inside( const P& p, const P& lower, const P& upper )
+{
+    for( int i = 0; i < lower.size(); ++i ) { if( comma::math::less( p[i], lower[i] ) || comma::math::less( upper[i], p[i] ) ) { return false; } }
+    return true;
+}
 
-template< typename P, typename T >
-struct PointMap : public impl::MultidimensionalMapimpl< typename P::Scalar, T, P::RowsAtCompileTime, impl::Less< typename P::Scalar > >
-{
-    typedef typename impl::MultidimensionalMapimpl< typename P::Scalar, T, P::RowsAtCompileTime, impl::Less< typename P::Scalar > > Base;
-    
-    //const T* find( const P& p ) const { return const_cast< PointMap* >( this )->Base::find( p ); }
-    //T* find( const P& p ) { return Base::find( p ); }
-    //std::vector< const T* > find( const P& p ) const { return const_cast< PointMap* >( this )->Base::find( p ); }
-    // a nasty hack violating constness: fix! well, later...
-    std::vector< T* > find( const P& p ) const { return const_cast< PointMap* >( this )->Base::find( p ); }
-    std::vector< T* > find( const P& p ) { return Base::find( p ); }
-    void insert( const P& p, const T& t ) { Base::insert( p, t ); }
-    void insert( const PointMap& m ) { for( PointMap::ConstEnumerator en = m.begin(); !en.end(); ++en ) { Base::insert( en.key(), en.value() ); } }
-    void erase( const P& p ) { return Base::erase( p ); }
-    void erase( const PointMap& m ) { for( PointMap::ConstEnumerator en = m.begin(); !en.end(); ++en ) { Base::erase( en.key() ); } }
-    PointMap find( const P& lower, const P& upper ) const { PointMap m; Base::find( m, lower, upper ); return m; }
-    std::size_t size() const { return Base::size(); }
-    
-    class ConstEnumerator // quick and dirty; too lame to be called iterator
+template< typename P >
+template < typename F >
+inline void PointMap< P >::find( unsigned int level, std::size_t i, const P& lower, const P& upper, F& f ) const
+{
+    if( !overlaps( m_boxes[ level ][i], lower, upper ) ) { return; }
+    if( level > 0 )
     {
-        public:
-            ConstEnumerator& operator++() { ++m_enum; m_enum.get( m_key, m_value ); return *this; }
-            bool end() const { return m_value == NULL; }
-            const P& key() const { return m_key; }
-            //T& value() { return *m_value; }
-            const T& value() const { return *m_value; }
-            
-        protected:
-            friend struct PointMap;
-            P m_key;
-            T* m_value;
-            typename PointMap::Base::Enumerator m_enum;
-    };
-    
-    class Enumerator : public ConstEnumerator // quick and dirty; too lame to be called iterator
+        std::size_t end = std::min< std::size_t >( ( i + 1 ) * fanout, m_boxes[ level - 1 ].size() );
+        for( std::size_t j = i * fanout; j < end; ++j ) { find( level - 1, j, lower, upper, f ); }
+        return;
+    }
+    std::size_t end = std::min< std::size_t >( ( i + 1 ) * block, m_indices.size() );
+    for( std::size_t j = i * block; j < end; ++j )
     {
-        public:
-            T& value() { return *this->m_value; }
-    };
-    
-    ConstEnumerator begin() const { ConstEnumerator e; const_cast< PointMap* >( this )->Base::setBegin( e.m_enum ); e.m_enum.get( e.m_key, e.m_value ); return e; }
-    Enumerator begin() { Enumerator e; this->Base::setBegin( e.m_enum ); e.m_enum.get( e.m_key, e.m_value ); return e; }
-    
-    std::string toString() const // quick and dirty; for testing
+        const P& p = ( *m_column )[ m_indices[j] ];
+        if( inside( p, lower, upper ) ) { f( p, m_indices[j] ); }
+    }
+}
+
+template< typename P >
+template < typename F >
+inline void PointMap< P >::find( const P& lower, const P& upper, F& f ) const
+{
+    index();
+    if( m_boxes.empty() ) { return; }
+    find( m_boxes.size() - 1, 0, lower, upper, f );
+}
+
+template< typename P >
+inline std::string PointMap< P >::toString() const
+{
+    flush();
+    std::ostringstream oss;
+    oss << "size = " << m_indices.size() << ":" << std::endl;
+    for( std::size_t i = 0; i < m_indices.size(); ++i )
     {
-        std::ostringstream oss;
-        this->Base::toString( oss );
-        return oss.str();
+        const P& p = ( *m_column )[ m_indices[i] ];
+        for( int j = 0; j < p.size(); ++j ) { oss << ( j == 0 ? "    " : "," ) << p[j]; }
+        oss << ":" << m_indices[i] << std::endl;
     }
-};
+    return oss.str();
+}
 
 } // namespace snark {
 
 #endif // SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_POINTMAP_H_
-
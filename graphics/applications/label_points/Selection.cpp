@@ -0,0 +1,148 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <iterator>
+#include "./Selection.h"
+
+namespace snark { namespace graphics { namespace View {
+
+std::size_t bits( comma::uint64 word )
+{
+    std::size_t count = 0;
+    for( ; word != 0; word &= word - 1, ++count ); // one iteration per set bit
+    return count;
+}
+
+namespace {
+
+struct ByIndex { bool operator()( const Partition::Word& a, const Partition::Word& b ) const { return a.index < b.index; } };
+
+struct Union { static comma::uint64 apply( comma::uint64 word, comma::uint64 mask ) { return word | mask; } };
+
+struct Difference { static comma::uint64 apply( comma::uint64 word, comma::uint64 mask ) { return word & ~mask; } };
+
+} // namespace {
+
+void Partition::insert( comma::uint32 index )
+{
+    comma::uint32 w = index / 64;
+    comma::uint64 bit = comma::uint64( 1 ) << ( index % 64 );
+    if( !m_words.empty() && m_words.back().index == w ) { if( !( m_words.back().bits & bit ) ) { m_words.back().bits |= bit; ++m_count; } }
+    else if( m_words.empty() || m_words.back().index < w ) { Word word = { w, bit }; m_words.push_back( word ); ++m_count; }
+    else { m_pending.push_back( index ); }
+}
+
+void Partition::normalise() // merge pending records as words into words
+{
+    if( m_pending.empty() ) { return; }
+    std::sort( m_pending.begin(), m_pending.end() );
+    std::vector< Word > pending;
+    for( std::size_t i = 0; i < m_pending.size(); ++i )
+    {
+        comma::uint32 w = m_pending[i] / 64;
+        if( pending.empty() || pending.back().index != w ) { Word word = { w, 0 }; pending.push_back( word ); }
+        pending.back().bits |= comma::uint64( 1 ) << ( m_pending[i] % 64 );
+    }
+    std::vector< comma::uint32 >().swap( m_pending );
+    std::vector< Word > words;
+    words.reserve( m_words.size() + pending.size() );
+    std::merge( m_words.begin(), m_words.end(), pending.begin(), pending.end(), std::back_inserter( words ), ByIndex() );
+    std::size_t size = 0;
+    m_count = 0;
+    for( std::size_t i = 0; i < words.size(); ++i ) // or words with the same index
+    {
+        if( size > 0 && words[ size - 1 ].index == words[i].index ) { words[ size - 1 ].bits |= words[i].bits; }
+        else { words[ size++ ] = words[i]; }
+    }
+    words.resize( size );
+    for( std::size_t i = 0; i < words.size(); ++i ) { m_count += bits( words[i].bits ); }
+    m_words.swap( words );
+}
+
+std::vector< comma::uint32 > Partition::indices() const
+{
+    std::vector< comma::uint32 > v;
+    v.reserve( m_count );
+    for( std::size_t i = 0; i < m_words.size(); ++i )
+    {
+        for( comma::uint64 word = m_words[i].bits, j = 0; word != 0; word >>= 1, ++j ) { if( word & 1 ) { v.push_back( comma::uint32( m_words[i].index * 64 + j ) ); } }
+    }
+    return v;
+}
+
+Selection::Selection( std::size_t size ) : m_words( ( size + 63 ) / 64, 0 ), m_count( 0 ), m_version( 0 ) {}
+
+template < typename Operation >
+void Selection::apply( const std::vector< comma::uint32 >& indices ) // gather indices falling into the same word into a mask, then update the word at once; partitions are sorted, thus mostly one update per word
+{
+    for( std::size_t i = 0; i < indices.size(); )
+    {
+        std::size_t w = indices[i] / 64;
+        comma::uint64 mask = 0;
+        for( ; i < indices.size() && indices[i] / 64 == w; ++i ) { mask |= comma::uint64( 1 ) << ( indices[i] % 64 ); }
+        apply< Operation >( w, mask );
+    }
+    ++m_version;
+}
+
+template < typename Operation >
+void Selection::apply( const Partition& partition )
+{
+    const std::vector< Partition::Word >& words = partition.words();
+    for( std::size_t i = 0; i < words.size(); ++i ) { apply< Operation >( words[i].index, words[i].bits ); }
+    ++m_version;
+}
+
+template < typename Operation >
+void Selection::apply( std::size_t w, comma::uint64 mask )
+{
+    comma::uint64 word = Operation::apply( m_words[w], mask );
+    if( word == m_words[w] ) { return; }
+    m_count = m_count + bits( word ) - bits( m_words[w] );
+    m_words[w] = word;
+}
+
+void Selection::insert( const std::vector< comma::uint32 >& indices ) { apply< Union >( indices ); }
+
+void Selection::erase( const std::vector< comma::uint32 >& indices ) { apply< Difference >( indices ); }
+
+void Selection::insert( const Partition& partition ) { apply< Union >( partition ); }
+
+void Selection::erase( const Partition& partition ) { apply< Difference >( partition ); }
+
+void Selection::clear()
+{
+    if( m_count == 0 ) { return; }
+    std::fill( m_words.begin(), m_words.end(), 0 );
+    m_count = 0;
+    ++m_version;
+}
+
+std::vector< comma::uint32 > Selection::indices() const
+{
+    std::vector< comma::uint32 > v;
+    v.reserve( m_count );
+    for( std::size_t i = 0; i < m_words.size(); ++i )
+    {
+        for( comma::uint64 word = m_words[i], j = 0; word != 0; word >>= 1, ++j ) { if( word & 1 ) { v.push_back( comma::uint32( i * 64 + j ) ); } } // empty words cost one comparison
+    }
+    return v;
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
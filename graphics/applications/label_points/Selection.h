@@ -0,0 +1,128 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_SELECTION_H_
+#define SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_SELECTION_H_
+
+#include <vector>
+#include <comma/base/types.h>
+
+namespace snark { namespace graphics { namespace View {
+
+/// record indices of a partition as a sparse bitset: non-zero 64-bit words with their positions in ascending order,
+/// thus a partition can be selected a word at a time, and a word costs 12 bytes, while an index would cost 4
+class Partition
+{
+    public:
+        struct Word
+        {
+            comma::uint32 index; // of word, i.e. word holds records [ 64 * index, 64 * index + 64 )
+            comma::uint64 bits;
+        };
+
+        Partition() : m_count( 0 ) {}
+
+        /// add record; records added in ascending order go straight into words, others are merged by normalise()
+        void insert( comma::uint32 index );
+
+        /// merge records added out of order
+        void normalise();
+
+        /// keep only records for which predicate( index ) is true; call after normalise()
+        template < typename Predicate > void keep( const Predicate& predicate );
+
+        /// return number of records
+        std::size_t size() const { return m_count; }
+        bool empty() const { return m_count == 0; }
+
+        /// return non-zero words in ascending order
+        const std::vector< Word >& words() const { return m_words; }
+
+        /// return record indices in ascending order
+        std::vector< comma::uint32 > indices() const;
+
+    private:
+        std::vector< Word > m_words;
+        std::vector< comma::uint32 > m_pending; // added out of order
+        std::size_t m_count;
+};
+
+/// selected records of a dataset as a bitset over record indices
+class Selection
+{
+    public:
+        /// @param size number of records
+        Selection( std::size_t size = 0 );
+        void insert( const std::vector< comma::uint32 >& indices );
+        void erase( const std::vector< comma::uint32 >& indices );
+
+        /// insert or erase a partition a word at a time, i.e. in time proportional to the number of its non-zero words
+        void insert( const Partition& partition );
+        void erase( const Partition& partition );
+        void clear();
+        bool contains( comma::uint32 index ) const { return ( m_words[ index / 64 ] & ( comma::uint64( 1 ) << ( index % 64 ) ) ) != 0; }
+        bool empty() const { return m_count == 0; }
+
+        /// return number of selected records
+        std::size_t size() const { return m_count; }
+
+        /// return selected indices in ascending order
+        std::vector< comma::uint32 > indices() const;
+
+        /// return number of 64-bit words in the bitset
+        std::size_t words() const { return m_words.size(); }
+
+        /// return i-th word of the bitset, e.g. to compare selections 64 records at a time
+        comma::uint64 word( std::size_t i ) const { return m_words[i]; }
+
+        /// return number of changes so far, e.g. to find out whether anything drawn from the selection is outdated
+        comma::uint64 version() const { return m_version; }
+
+    private:
+        template < typename Operation > void apply( const std::vector< comma::uint32 >& indices );
+        template < typename Operation > void apply( const Partition& partition );
+        template < typename Operation > void apply( std::size_t w, comma::uint64 mask );
+        std::vector< comma::uint64 > m_words;
+        std::size_t m_count;
+        comma::uint64 m_version;
+};
+
+std::size_t bits( comma::uint64 word ); // number of set bits
+
+template < typename Predicate >
+inline void Partition::keep( const Predicate& predicate )
+{
+    std::size_t size = 0;
+    m_count = 0;
+    for( std::size_t i = 0; i < m_words.size(); ++i )
+    {
+        Word w = m_words[i];
+        for( comma::uint64 b = m_words[i].bits, j = 0; b != 0; b >>= 1, ++j )
+        {
+            if( ( b & 1 ) && !predicate( comma::uint32( w.index * 64 + j ) ) ) { w.bits &= ~( comma::uint64( 1 ) << j ); }
+        }
+        if( w.bits == 0 ) { continue; }
+        m_words[ size++ ] = w;
+        m_count += bits( w.bits );
+    }
+    m_words.resize( size );
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif // SNARK_GRAPHICS_APPLICATIONS_LABELPOINTS_SELECTION_H_
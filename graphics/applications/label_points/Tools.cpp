@@ -37,6 +37,12 @@ static unsigned char colorIndex = 0;
 static boost::array< unsigned int, 256 > colorIndices = colorInit();
 static void colorShake() { std::random_shuffle( colorIndices.begin(), colorIndices.end() ); ++colorIndex; }
 
+struct CollectIndices // visitor for Dataset::Points::find()
+{
+    std::vector< comma::uint32 > indices;
+    void operator()( const Eigen::Vector3d&, comma::uint32 index ) { indices.push_back( index ); }
+};
+
 } // namespace impl {
 
 QColor4ub colorFromId( comma::uint32 id ) // quick and dirty, arbitrary
@@ -97,11 +103,7 @@ void PickId::onMousePress( QMouseEvent* e )
 void PickId::shakeColors()
 {
     impl::colorShake();
-    for( std::size_t i = 0; i < m_viewer.m_datasets.size(); ++i )
-    {
-        m_viewer.m_datasets[i]->init();
-        m_viewer.m_datasets[i]->selection().init();
-    }
+    for( std::size_t i = 0; i < m_viewer.m_datasets.size(); ++i ) { m_viewer.m_datasets[i]->init(); }
     if( m_viewer.m_id ) { emit valueChanged( *m_viewer.m_id ); }
     m_viewer.update();
 }
@@ -126,8 +128,10 @@ void SelectPartition::onMousePress( QMouseEvent* e )
             if( !erase && !m_viewer.dataset( i ).visible() ) { continue; }
             Dataset::Partitions::const_iterator it = m_viewer.dataset( i ).partitions().find( picked->second );
             if( it == m_viewer.dataset( i ).partitions().end() ) { continue; }
-            //if( it->second.find( picked->first ) == NULL ) { continue; }
-            if( it->second.find( picked->first ).empty() ) { continue; }
+            std::vector< comma::uint32 > indices = m_viewer.dataset( i ).points().find( picked->first );
+            bool found = false;
+            for( std::size_t j = 0; j < indices.size() && !found; ++j ) { found = m_viewer.dataset( i ).id( indices[j] ) == picked->second; }
+            if( !found ) { continue; }
             if( erase ) { m_viewer.dataset( i ).selection().erase( it->second ); }
             else { m_viewer.dataset( i ).selection().insert( it->second ); }
             std::cerr << "label-points: partition id " << picked->second << " with " << it->second.size() << " point(s) in " << m_viewer.dataset( i ).filename() << ( erase ? " removed from selection" : append ? " added to selection" : " selected" ) << std::endl;
@@ -180,7 +184,7 @@ void Fill::onMousePress( QMouseEvent* e )
     if( !m_viewer.m_id ) { return; }
     std::cerr << " id " << *m_viewer.m_id << std::endl;
     bool selectionEmpty = true;
-    for( std::size_t i = 0; i < m_viewer.datasets().size() && selectionEmpty; ++i ) { selectionEmpty = m_viewer.dataset( i ).selection().points().empty(); }
+    for( std::size_t i = 0; i < m_viewer.datasets().size() && selectionEmpty; ++i ) { selectionEmpty = m_viewer.dataset( i ).selection().empty(); }
     if( selectionEmpty )
     {
         boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > picked = m_viewer.pointSelection( e->pos(), true );
@@ -197,16 +201,23 @@ void Fill::onMousePress( QMouseEvent* e )
     {
         for( std::size_t i = 0; i < m_viewer.datasets().size(); ++i )
         {
-            if( m_viewer.dataset( i ).selection().points().empty() ) { continue; }
+            if( m_viewer.dataset( i ).selection().empty() ) { continue; }
+            boost::optional< std::vector< Eigen::Vector3d > > points; // of selection, to label other datasets, only if needed
             for( std::size_t j = 0; j < m_viewer.datasets().size(); ++j )
             {
                 if( !m_viewer.dataset( j ).writable() || !m_viewer.dataset( j ).visible() ) { continue; }
-                m_viewer.dataset( j ).label( m_viewer.dataset( i ).selection().points(), *m_viewer.m_id );
+                if( j == i ) { m_viewer.dataset( j ).label( m_viewer.dataset( i ).selection(), *m_viewer.m_id ); }
+                else
+                {
+                    if( !points ) { points = m_viewer.dataset( i ).selectedPoints(); }
+                    m_viewer.dataset( j ).label( *points, *m_viewer.m_id );
+                }
                 std::cerr << "label-points: labeled selection with id " << *m_viewer.m_id << " in " << m_viewer.dataset( j ).filename() << std::endl;
             }
             m_viewer.dataset( i ).selection().clear();
         }
     }
+    m_viewer.finishStep();
     m_viewer.update();
 }
 
@@ -252,10 +263,11 @@ void SelectClip::onMouseRelease( QMouseEvent* e )
     for( std::size_t i = 0; i < m_viewer.datasets().size(); ++i )
     {
         if( !erase && !m_viewer.dataset( i ).visible() ) { continue; }
-        Dataset::Points m = m_viewer.dataset( i ).points().find( extents.min(), extents.max() );
-        if( erase ) { m_viewer.dataset( i ).selection().erase( m ); }
-        else { m_viewer.dataset( i ).selection().insert( m ); }
-        std::cerr << "label-points: " << m.size() << " point(s) from " << m_viewer.dataset( i ).filename() << ( erase ? " removed from selection" : append ? " added to selection" : " selected" ) << std::endl;
+        impl::CollectIndices collect;
+        m_viewer.dataset( i ).points().find( extents.min(), extents.max(), collect );
+        if( erase ) { m_viewer.dataset( i ).selection().erase( collect.indices ); }
+        else { m_viewer.dataset( i ).selection().insert( collect.indices ); }
+        std::cerr << "label-points: " << collect.indices.size() << " point(s) from " << m_viewer.dataset( i ).filename() << ( erase ? " removed from selection" : append ? " added to selection" : " selected" ) << std::endl;
     }
     m_rectangle = boost::optional< QRect >();
     m_viewer.update();
@@ -16,6 +16,7 @@
 // You should have received a copy of the GNU General Public
 // License along with snark. If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <boost/array.hpp> 
@@ -39,6 +40,7 @@ Viewer::Viewer( const std::vector< comma::csv::options >& options
     , m_currentTool( &navigate )
     , m_options( options )
     , m_labelDuplicated( labelDuplicated )
+    , m_picking( false )
 {
 
 }
@@ -64,6 +66,34 @@ void Viewer::save()
     }
 }
 
+void Viewer::finishStep()
+{
+    std::vector< std::size_t > changed;
+    for( std::size_t i = 0; i < m_datasets.size(); ++i ) { if( m_datasets[i]->finishStep() ) { changed.push_back( i ); } }
+    if( changed.empty() ) { return; }
+    m_undo.push_back( changed );
+    m_redo.clear();
+}
+
+void Viewer::undo()
+{
+    finishStep();
+    if( m_undo.empty() ) { std::cerr << "label-points: nothing to undo" << std::endl; return; }
+    for( std::size_t i = 0; i < m_undo.back().size(); ++i ) { m_datasets[ m_undo.back()[i] ]->undo(); }
+    m_redo.push_back( m_undo.back() );
+    m_undo.pop_back();
+    update();
+}
+
+void Viewer::redo()
+{
+    if( m_redo.empty() ) { std::cerr << "label-points: nothing to redo" << std::endl; return; }
+    for( std::size_t i = 0; i < m_redo.back().size(); ++i ) { m_datasets[ m_redo.back()[i] ]->redo(); }
+    m_undo.push_back( m_redo.back() );
+    m_redo.pop_back();
+    update();
+}
+
 const std::vector< boost::shared_ptr< Dataset > >& Viewer::datasets() const { return m_datasets; }
 
 Dataset& Viewer::dataset( std::size_t index ) { return *m_datasets[index]; }
@@ -78,13 +108,17 @@ void Viewer::reload()
         comma::csv::options options = m_datasets[i]->options();
         bool writable = m_datasets[i]->writable();
         bool visible = m_datasets[i]->visible();
+        m_datasets[i]->discard(); // otherwise, unsaved changes would be recovered
         m_datasets[i].reset();
-        m_datasets[i].reset( new Dataset( filename, options, *m_offset, m_labelDuplicated ) );
+        m_datasets[i].reset( new Dataset( filename, options, *m_offset, m_labelDuplicated, writable ) );
         if( !m_datasets[i]->valid() ) { std::cerr << "label-points: failed to reload datasets" << std::endl; exit( -1 ); }
         m_datasets[i]->init();
         m_datasets[i]->writable( writable );
         m_datasets[i]->visible( visible );
     }
+    m_undo.clear();
+    m_redo.clear();
+    finishStep(); // re-labelled duplicated points, if any
     setCamera();
     update();
 }
@@ -107,6 +141,8 @@ void Viewer::setCamera()
 void Viewer::initializeGL( QGLPainter *painter )
 {
     ::glDisable( GL_LIGHTING );
+    m_picking = qt3d::pick_buffer::supported();
+    if( !m_picking ) { std::cerr << "label-points: picking on gpu not supported, will pick on cpu" << std::endl; }
 //     setBackgroundColor( QColor( m_background_color.red(), m_background_color.green(), m_background_color.blue() ) );
     m_datasets.push_back( boost::shared_ptr< Dataset >( new Dataset( m_options[0].filename, m_options[0], m_labelDuplicated ) ) );
     if( !m_datasets[0]->valid() ) { std::cerr << "label-points: failed to load dataset " << m_options[0].filename << std::endl; exit( -1 ); }
@@ -116,12 +152,13 @@ void Viewer::initializeGL( QGLPainter *painter )
     m_offset = m_datasets[0]->offset();
     for( std::size_t i = 1; i < m_options.size(); ++i )
     {
-        m_datasets.push_back( boost::shared_ptr< Dataset >( new Dataset( m_options[i].filename, m_options[i], *m_offset, m_labelDuplicated ) ) );
+        m_datasets.push_back( boost::shared_ptr< Dataset >( new Dataset( m_options[i].filename, m_options[i], *m_offset, m_labelDuplicated, false ) ) );
         if( !m_datasets.back()->valid() ) { std::cerr << "label-points: failed to load dataset " << m_options[i].filename << std::endl; exit( -1 ); }
         m_datasets.back()->init();
         m_datasets.back()->writable( false );
         m_datasets.back()->visible( true );
     }
+    finishStep(); // re-labelled duplicated points, if any
     setCamera();
 }
 
@@ -139,7 +176,7 @@ void Viewer::paintGL( QGLPainter *painter )
     }
     ::glEnable( GL_POINT_SMOOTH );
     ::glPointSize( selectionPointSize );
-    for( std::size_t i = 0; i < m_datasets.size(); ++i ) { m_datasets[i]->selection().draw( painter ); }
+    for( std::size_t i = 0; i < m_datasets.size(); ++i ) { m_datasets[i]->drawSelection( painter ); }
     ::glDisable( GL_POINT_SMOOTH );
     m_currentTool->draw( painter );
     draw_coordinates( painter );
@@ -163,8 +200,69 @@ void Viewer::mouseMoveEvent( QMouseEvent *e )
 //     GL::View::mouseMoveEvent( e );
 }
 
+namespace {
+
+struct Nearest // visitor for Dataset::Points::find(); visiting order is arbitrary, hence ties go to the point that sorts first, as before
+{
+    const Eigen::Vector3d& clicked;
+    double squaredDistance;
+    std::size_t count;
+    bool found;
+    Eigen::Vector3d point;
+    comma::uint32 index;
+    Nearest( const Eigen::Vector3d& clicked, double squaredDistance ) : clicked( clicked ), squaredDistance( squaredDistance ), count( 0 ), found( false ) {}
+    void operator()( const Eigen::Vector3d& p, comma::uint32 i )
+    {
+        ++count;
+        double norm = ( p - clicked ).squaredNorm();
+        if( norm > squaredDistance ) { return; }
+        if( norm == squaredDistance && ( !found || !( snark::impl::LexicographicLess< Eigen::Vector3d >()( p, point ) || ( p == point && i < index ) ) ) ) { return; }
+        found = true;
+        squaredDistance = norm;
+        point = p;
+        index = i;
+    }
+};
+
+} // namespace {
+
+boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > Viewer::pick( const QPoint& point, bool writableOnly ) // draw point numbers offscreen and read back pixels around the click at once
+{
+    makeCurrent();
+    QGLPainter painter( this );
+    m_pick.begin( &painter, size(), camera() );
+    ::glPointSize( 1 ); // as points are drawn in paintGL()
+    std::vector< comma::uint32 > bases( m_datasets.size() + 1, 0 );
+    for( std::size_t i = 0; i < m_datasets.size(); ++i )
+    {
+        bases[ i + 1 ] = bases[i] + m_datasets[i]->points().size();
+        if( !writableOnly || m_datasets[i]->writable() ) { m_datasets[i]->drawPick( &painter, m_pick, bases[i] ); }
+    }
+    static const int radius = 2; // in pixels, to have more chance to hit
+    std::vector< std::pair< QPoint, comma::uint32 > > picked = m_pick.read( QRect( point - QPoint( radius, radius ), point + QPoint( radius, radius ) ) );
+    if( !m_pick.end( &painter ) )
+    {
+        std::cerr << "label-points: picking on gpu failed, will pick on cpu" << std::endl;
+        m_picking = false;
+        return pointSelection( point, writableOnly );
+    }
+    std::size_t nearest = picked.size();
+    for( std::size_t i = 0; i < picked.size(); ++i )
+    {
+        if( nearest == picked.size() || ( picked[i].first - point ).manhattanLength() < ( picked[ nearest ].first - point ).manhattanLength() ) { nearest = i; }
+    }
+    if( nearest == picked.size() ) { return boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > >(); }
+    comma::uint32 n = picked[ nearest ].second - 1;
+    std::size_t i = std::upper_bound( bases.begin(), bases.end(), n ) - bases.begin() - 1;
+    const Dataset::Points& points = m_datasets[i]->points();
+    comma::uint32 id = m_datasets[i]->id( points.value( n - bases[i] ) );
+    std::cerr << " found point " << points.key( n - bases[i] ) << " , id " << id << std::endl;
+    return std::make_pair( points.key( n - bases[i] ), id );
+}
+
 boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > Viewer::pointSelection( const QPoint& point, bool writableOnly )
 {
+    if( m_picking ) { return pick( point, writableOnly ); }
     boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > result;
     boost::optional< QVector3D > point3d = getPoint( point );
     if( point3d )
@@ -183,16 +281,13 @@ boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > Viewer::pointSele
         for( std::size_t i = 0; i < m_datasets.size(); ++i )
         {
             if( !m_datasets[i]->visible() || ( writableOnly && !m_datasets[i]->writable() ) ) { continue; }
-            Dataset::Points m = m_datasets[i]->points().find( e.min(), e.max() );
-            std::cerr << " found " << m.size() << " points " << std::endl;
-            for( Dataset::Points::ConstEnumerator en = m.begin(); !en.end(); ++en )
+            Nearest nearest( p, minDistanceSquare );
+            m_datasets[i]->points().find( e.min(), e.max(), nearest ); // no temporary point map
+            std::cerr << " found " << nearest.count << " points " << std::endl;
+            if( nearest.found )
             {
-                double norm = ( en.key() - p ).squaredNorm();
-                if( norm < minDistanceSquare )
-                {
-                    minDistanceSquare = norm;
-                    result = std::make_pair( en.key(), en.value().id );
-                }
+                minDistanceSquare = nearest.squaredDistance;
+                result = std::make_pair( nearest.point, m_datasets[i]->id( nearest.index ) );
             }
             if( minDistanceSquare <= 0.01 )
             {
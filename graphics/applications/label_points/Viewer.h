@@ -67,6 +67,9 @@ class Viewer : public qt3d::view
         void setWritable( std::size_t i, bool writable ); // quick and dirty
         void save();
         void reload();
+        void finishStep(); // finish edit step in all datasets, e.g. after a click, to undo it as a whole
+        void undo();
+        void redo();
         const std::vector< boost::shared_ptr< Dataset > >& datasets() const;
         Dataset& dataset( std::size_t index ); // quick and dirty
         const Dataset& dataset( std::size_t index ) const; // quick and dirty
@@ -85,6 +88,7 @@ class Viewer : public qt3d::view
         void mouseReleaseEvent( QMouseEvent* e );
         void mouseMoveEvent( QMouseEvent* e );
         boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > pointSelection( const QPoint& point, bool writableOnly = false );
+        boost::optional< std::pair< Eigen::Vector3d, comma::uint32 > > pick( const QPoint& point, bool writableOnly );
 
     private:
         friend class Tools::Tool; // quick and dirty
@@ -97,6 +101,8 @@ class Viewer : public qt3d::view
                 
         Tools::Tool* m_currentTool;
         std::vector< boost::shared_ptr< Dataset > > m_datasets;
+        std::vector< std::vector< std::size_t > > m_undo; // datasets changed in each edit step
+        std::vector< std::vector< std::size_t > > m_redo;
         boost::optional< comma::uint32 > m_id;
         const QColor4ub m_background_color;
         std::vector< comma::csv::options > m_options;
@@ -106,6 +112,8 @@ class Viewer : public qt3d::view
         boost::optional< QPoint > m_startPan;
         boost::optional< QPoint > m_startRotate;
         double m_sceneRadius;
+        qt3d::pick_buffer m_pick;
+        bool m_picking; // pick on gpu, if supported
 };
 
 } } } // namespace snark { namespace graphics { namespace View {
@@ -0,0 +1,170 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <fstream>
+#include <boost/filesystem/operations.hpp>
+#include <gtest/gtest.h>
+#include "../Dataset.h"
+
+namespace snark { namespace graphics { namespace View {
+
+namespace Tools { QColor4ub colorFromId( comma::uint32 id ) { return QColor4ub( id, 0, 0 ); } } // quick and dirty: instead of linking the gui
+
+class DatasetTest : public ::testing::Test // dataset of 1000 points on a 10x10x10 grid, labelled with ids 0, 1, 2 in turn
+{
+    protected:
+        std::string filename;
+        comma::csv::options options;
+
+        void SetUp()
+        {
+            filename = ( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "dataset-test-%%%%-%%%%.csv" ) ).string();
+            std::ofstream ofs( filename.c_str() );
+            for( int i = 0; i < 1000; ++i ) { ofs << i % 10 << "," << ( i / 10 ) % 10 << "," << i / 100 << "," << i % 3 << std::endl; }
+            options.filename = filename;
+            options.fields = "x,y,z,id";
+        }
+
+        void TearDown()
+        {
+            boost::filesystem::remove( filename );
+            boost::filesystem::remove( journal() );
+        }
+
+        std::string journal() const { return filename + ".journal"; }
+
+        static std::size_t count( const Dataset& d, comma::uint32 id )
+        {
+            Dataset::Partitions::const_iterator it = d.partitions().find( id );
+            return it == d.partitions().end() ? 0 : it->second.size();
+        }
+};
+
+TEST_F( DatasetTest, undo_redo )
+{
+    Dataset d( filename, options, false );
+    d.label( Eigen::Vector3d( 0, 0, 0 ), 7 );
+    d.label( Eigen::Vector3d( 1, 0, 0 ), 7 );
+    EXPECT_TRUE( d.finishStep() );
+    EXPECT_FALSE( d.finishStep() );
+    d.label( Eigen::Vector3d( 0, 0, 0 ), 8 );
+    d.finishStep();
+    EXPECT_EQ( 1u, count( d, 7 ) );
+    EXPECT_EQ( 1u, count( d, 8 ) );
+    EXPECT_TRUE( d.undo() );
+    EXPECT_EQ( 2u, count( d, 7 ) );
+    EXPECT_EQ( 0u, count( d, 8 ) );
+    EXPECT_TRUE( d.undo() );
+    EXPECT_EQ( 0u, count( d, 7 ) );
+    EXPECT_EQ( 334u, count( d, 0 ) );
+    EXPECT_EQ( 333u, count( d, 1 ) );
+    EXPECT_FALSE( d.undo() );
+    EXPECT_TRUE( d.redo() );
+    EXPECT_TRUE( d.redo() );
+    EXPECT_FALSE( d.redo() );
+    EXPECT_EQ( 1u, count( d, 7 ) );
+    EXPECT_EQ( 1u, count( d, 8 ) );
+    d.discard();
+}
+
+TEST_F( DatasetTest, replay_after_crash )
+{
+    {
+        Dataset d( filename, options, false );
+        d.selection().insert( d.partitions().find( 1 )->second );
+        d.label( d.selection(), 5 );
+        d.finishStep();
+        d.label( Eigen::Vector3d( 0, 0, 0 ), 7 );
+        d.finishStep();
+        d.undo();
+        d.label( Eigen::Vector3d( 2, 0, 0 ), 9 );
+        d.finishStep();
+    } // neither saved nor discarded, as if crashed
+    Dataset d( filename, options, false );
+    EXPECT_TRUE( d.modified() );
+    EXPECT_EQ( 333u, count( d, 5 ) );
+    EXPECT_EQ( 0u, count( d, 1 ) );
+    EXPECT_EQ( 0u, count( d, 7 ) );
+    EXPECT_EQ( 1u, count( d, 9 ) );
+    EXPECT_EQ( 332u, count( d, 2 ) ); // record 2 relabelled
+    EXPECT_EQ( 334u, count( d, 0 ) ); // record 0 relabelled and undone
+    Dataset r( filename, options, false, false ); // read-only: nothing gets recovered
+    EXPECT_FALSE( r.modified() );
+    EXPECT_EQ( 333u, count( r, 1 ) );
+    d.discard();
+}
+
+TEST_F( DatasetTest, truncated_journal )
+{
+    {
+        Dataset d( filename, options, false );
+        d.label( Eigen::Vector3d( 0, 0, 0 ), 7 );
+        d.finishStep();
+        d.label( Eigen::Vector3d( 1, 0, 0 ), 8 );
+        d.finishStep();
+    }
+    boost::filesystem::resize_file( journal(), boost::filesystem::file_size( journal() ) - 1 ); // crashed while writing the last step
+    Dataset d( filename, options, false );
+    EXPECT_EQ( 1u, count( d, 7 ) );
+    EXPECT_EQ( 0u, count( d, 8 ) );
+    EXPECT_EQ( 333u, count( d, 1 ) );
+    d.discard();
+}
+
+TEST_F( DatasetTest, journal_not_matching )
+{
+    {
+        Dataset d( filename, options, false );
+        d.label( Eigen::Vector3d( 1, 0, 0 ), 8 ); // record 1 from 1 to 8
+        d.finishStep();
+    }
+    {
+        std::ofstream ofs( filename.c_str() ); // file changed behind the journal's back
+        for( int i = 0; i < 1000; ++i ) { ofs << i % 10 << "," << ( i / 10 ) % 10 << "," << i / 100 << ",4" << std::endl; }
+    }
+    Dataset d( filename, options, false );
+    EXPECT_FALSE( d.modified() );
+    EXPECT_EQ( 0u, count( d, 8 ) );
+    EXPECT_EQ( 1000u, count( d, 4 ) );
+}
+
+TEST_F( DatasetTest, save_truncates_journal )
+{
+    {
+        Dataset d( filename, options, false );
+        d.label( Eigen::Vector3d( 1, 0, 0 ), 8 );
+        d.finishStep();
+        EXPECT_TRUE( boost::filesystem::exists( journal() ) );
+        d.save();
+        EXPECT_FALSE( boost::filesystem::exists( journal() ) );
+        EXPECT_FALSE( d.modified() );
+        EXPECT_TRUE( d.undo() ); // history survives saving
+        EXPECT_EQ( 0u, count( d, 8 ) );
+        EXPECT_TRUE( boost::filesystem::exists( journal() ) ); // undo is an unsaved change again
+        d.discard();
+        EXPECT_FALSE( boost::filesystem::exists( journal() ) );
+    }
+    Dataset d( filename, options, false );
+    EXPECT_FALSE( d.modified() );
+    EXPECT_EQ( 1u, count( d, 8 ) ); // as saved
+    EXPECT_EQ( 332u, count( d, 1 ) );
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
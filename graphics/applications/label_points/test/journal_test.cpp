@@ -0,0 +1,149 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <fstream>
+#include <boost/filesystem/operations.hpp>
+#include <gtest/gtest.h>
+#include "../Journal.h"
+
+namespace snark { namespace graphics { namespace View {
+
+static Journal::Run run( comma::uint32 index, comma::uint32 size, comma::uint32 from, comma::uint32 to )
+{
+    Journal::Run r = { index, size, from, to };
+    return r;
+}
+
+static bool operator==( const Journal::Run& lhs, const Journal::Run& rhs ) { return lhs.index == rhs.index && lhs.size == rhs.size && lhs.from == rhs.from && lhs.to == rhs.to; }
+
+static std::string filename() { return ( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "journal-test-%%%%-%%%%.journal" ) ).string(); }
+
+TEST( Journal, runs )
+{
+    Journal journal;
+    EXPECT_FALSE( journal.finish() );
+    for( comma::uint32 i = 10; i < 15; ++i ) { journal.add( i, 1, 2 ); }
+    journal.add( 15, 3, 2 ); // different old id
+    journal.add( 17, 1, 2 ); // not adjacent
+    EXPECT_TRUE( journal.finish() );
+    Journal::Runs runs;
+    EXPECT_TRUE( journal.undo( runs ) );
+    ASSERT_EQ( 3u, runs.size() );
+    EXPECT_TRUE( runs[0] == run( 17, 1, 2, 1 ) ); // backwards, inverse
+    EXPECT_TRUE( runs[1] == run( 15, 1, 2, 3 ) );
+    EXPECT_TRUE( runs[2] == run( 10, 5, 2, 1 ) );
+}
+
+TEST( Journal, undo_redo )
+{
+    Journal journal;
+    Journal::Runs runs;
+    EXPECT_FALSE( journal.undo( runs ) );
+    EXPECT_FALSE( journal.redo( runs ) );
+    journal.add( 0, 0, 1 );
+    journal.finish();
+    journal.add( 1, 0, 2 );
+    journal.add( 1, 2, 3 ); // same record twice in a step
+    journal.finish();
+    EXPECT_TRUE( journal.undo( runs ) );
+    ASSERT_EQ( 2u, runs.size() );
+    EXPECT_TRUE( runs[0] == run( 1, 1, 3, 2 ) );
+    EXPECT_TRUE( runs[1] == run( 1, 1, 2, 0 ) );
+    EXPECT_TRUE( journal.undo( runs ) );
+    ASSERT_EQ( 1u, runs.size() );
+    EXPECT_TRUE( runs[0] == run( 0, 1, 1, 0 ) );
+    EXPECT_FALSE( journal.undo( runs ) );
+    EXPECT_TRUE( journal.redo( runs ) );
+    ASSERT_EQ( 1u, runs.size() );
+    EXPECT_TRUE( runs[0] == run( 0, 1, 0, 1 ) );
+    journal.add( 5, 0, 4 ); // undo step no longer redoable
+    EXPECT_FALSE( journal.redo( runs ) ); // finishes the pending step first
+    EXPECT_TRUE( journal.undo( runs ) );
+    ASSERT_EQ( 1u, runs.size() );
+    EXPECT_TRUE( runs[0] == run( 5, 1, 4, 0 ) );
+    EXPECT_TRUE( journal.undo( runs ) );
+    EXPECT_TRUE( runs[0] == run( 0, 1, 1, 0 ) );
+    EXPECT_FALSE( journal.undo( runs ) );
+}
+
+TEST( Journal, file )
+{
+    const std::string name = filename();
+    {
+        Journal journal( name );
+        journal.add( 0, 0, 1 );
+        journal.finish();
+        journal.add( 1, 0, 2 );
+        journal.finish();
+        Journal::Runs runs;
+        journal.undo( runs );
+        journal.redo( runs );
+        journal.undo( runs );
+    } // no truncate(), as if crashed
+    Journal::Runs runs = Journal::read( name );
+    ASSERT_EQ( 5u, runs.size() ); // replaying all of them gives the state before the crash
+    EXPECT_TRUE( runs[0] == run( 0, 1, 0, 1 ) );
+    EXPECT_TRUE( runs[1] == run( 1, 1, 0, 2 ) );
+    EXPECT_TRUE( runs[2] == run( 1, 1, 2, 0 ) );
+    EXPECT_TRUE( runs[3] == run( 1, 1, 0, 2 ) );
+    EXPECT_TRUE( runs[4] == run( 1, 1, 2, 0 ) );
+    boost::filesystem::remove( name );
+}
+
+TEST( Journal, truncated_last_step )
+{
+    const std::string name = filename();
+    {
+        Journal journal( name );
+        journal.add( 0, 0, 1 );
+        journal.finish();
+        journal.add( 1, 0, 2 );
+        journal.add( 3, 0, 2 );
+        journal.finish();
+    }
+    const boost::uintmax_t size = boost::filesystem::file_size( name );
+    for( boost::uintmax_t cut = 1; cut < sizeof( comma::uint32 ) + 2 * sizeof( Journal::Run ); ++cut ) // anywhere in the last step
+    {
+        boost::filesystem::resize_file( name, size - cut );
+        Journal::Runs runs = Journal::read( name );
+        ASSERT_EQ( 1u, runs.size() ) << "cut " << cut << " byte(s)";
+        EXPECT_TRUE( runs[0] == run( 0, 1, 0, 1 ) );
+    }
+    boost::filesystem::remove( name );
+}
+
+TEST( Journal, truncate )
+{
+    const std::string name = filename();
+    Journal journal( name );
+    journal.add( 0, 0, 1 );
+    journal.finish();
+    EXPECT_TRUE( boost::filesystem::exists( name ) );
+    journal.truncate();
+    EXPECT_FALSE( boost::filesystem::exists( name ) );
+    EXPECT_TRUE( Journal::read( name ).empty() );
+    Journal::Runs runs;
+    EXPECT_TRUE( journal.undo( runs ) ); // undo history is kept
+    EXPECT_TRUE( boost::filesystem::exists( name ) ); // and journaled again
+    EXPECT_EQ( 1u, Journal::read( name ).size() );
+    journal.truncate();
+    journal.truncate(); // no file: nothing to do
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
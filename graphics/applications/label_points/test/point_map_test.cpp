@@ -0,0 +1,142 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdlib>
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+#include <Eigen/Core>
+#include "../PointMap.h"
+
+namespace snark {
+
+typedef PointMap< Eigen::Vector3d > Map;
+
+static std::vector< Eigen::Vector3d > grid( std::size_t size, int cells )
+{
+    std::srand( 1 );
+    std::vector< Eigen::Vector3d > points( size );
+    for( std::size_t i = 0; i < size; ++i ) { points[i] = Eigen::Vector3d( std::rand() % cells, std::rand() % cells, std::rand() % cells ); }
+    return points;
+}
+
+struct Collect
+{
+    std::set< comma::uint32 > indices;
+    void operator()( const Eigen::Vector3d&, comma::uint32 index ) { indices.insert( index ); }
+};
+
+TEST( PointMap, find_point )
+{
+    std::vector< Eigen::Vector3d > points = grid( 2000, 10 ); // plenty of duplicates
+    Map map( &points );
+    for( std::size_t i = 0; i < points.size(); ++i ) { map.insert( i ); }
+    EXPECT_EQ( points.size(), map.size() );
+    for( int x = 0; x < 10; ++x )
+    {
+        for( int y = 0; y < 10; ++y )
+        {
+            Eigen::Vector3d p( x, y, x % 3 );
+            std::vector< comma::uint32 > expected;
+            for( std::size_t i = 0; i < points.size(); ++i ) { if( points[i] == p ) { expected.push_back( i ); } }
+            EXPECT_EQ( expected, map.find( p ) ); // in ascending order
+        }
+    }
+    EXPECT_TRUE( map.find( Eigen::Vector3d( 0.5, 0, 0 ) ).empty() );
+    EXPECT_TRUE( map.find( Eigen::Vector3d( 100, 0, 0 ) ).empty() );
+    EXPECT_TRUE( map.find( Eigen::Vector3d( -1, 0, 0 ) ).empty() );
+}
+
+TEST( PointMap, find_box )
+{
+    std::vector< Eigen::Vector3d > points = grid( 5000, 100 );
+    Map map( &points );
+    for( std::size_t i = 0; i < points.size(); ++i ) { map.insert( i ); }
+    for( unsigned int k = 0; k < 100; ++k )
+    {
+        Eigen::Vector3d lower( std::rand() % 100, std::rand() % 100, std::rand() % 100 );
+        Eigen::Vector3d upper = lower + Eigen::Vector3d( std::rand() % 30, std::rand() % 30, std::rand() % 30 );
+        std::set< comma::uint32 > expected;
+        for( std::size_t i = 0; i < points.size(); ++i ) { if( ( points[i].array() >= lower.array() ).all() && ( points[i].array() <= upper.array() ).all() ) { expected.insert( i ); } }
+        Collect collect;
+        map.find( lower, upper, collect );
+        EXPECT_EQ( expected, collect.indices );
+    }
+    Collect none;
+    map.find( Eigen::Vector3d( 200, 200, 200 ), Eigen::Vector3d( 300, 300, 300 ), none );
+    EXPECT_TRUE( none.indices.empty() );
+}
+
+TEST( PointMap, ordering )
+{
+    std::vector< Eigen::Vector3d > points = grid( 3000, 20 );
+    Map map( &points );
+    for( std::size_t i = points.size(); i > 0; --i ) { map.insert( i - 1 ); } // order of insertion does not matter
+    std::set< comma::uint32 > seen;
+    for( std::size_t i = 0; i < map.size(); ++i )
+    {
+        EXPECT_EQ( points[ map.value( i ) ], map.key( i ) );
+        seen.insert( map.value( i ) );
+        if( i == 0 || map.key( i ) != map.key( i - 1 ) ) { continue; }
+        EXPECT_LT( map.value( i - 1 ), map.value( i ) ); // equal points adjacent, in ascending order of indices
+    }
+    EXPECT_EQ( points.size(), seen.size() );
+    for( std::size_t i = 0; i < map.size(); ++i ) // equal points are all adjacent
+    {
+        std::size_t count = 0;
+        for( std::size_t j = i; j < map.size() && map.key( j ) == map.key( i ); ++j ) { ++count; }
+        EXPECT_EQ( map.find( map.key( i ) ).size(), count );
+        i += count - 1;
+    }
+}
+
+TEST( PointMap, erase_and_insert )
+{
+    std::vector< Eigen::Vector3d > points = grid( 2000, 10 );
+    Map map( &points );
+    for( std::size_t i = 0; i < points.size(); ++i ) { map.insert( i ); }
+    for( std::size_t i = 0; i < points.size(); i += 2 ) { map.erase( i ); } // one batch
+    EXPECT_EQ( points.size() / 2, map.size() );
+    for( std::size_t i = 0; i < map.size(); ++i ) { EXPECT_EQ( 1u, map.value( i ) % 2 ); }
+    std::vector< comma::uint32 > odd = map.find( points[1] );
+    EXPECT_FALSE( odd.empty() );
+    for( std::size_t i = 0; i < odd.size(); ++i ) { EXPECT_EQ( 1u, odd[i] % 2 ); }
+    for( std::size_t i = 0; i < points.size(); i += 2 ) { map.insert( i ); }
+    EXPECT_EQ( points.size(), map.size() );
+    std::vector< comma::uint32 > expected;
+    for( std::size_t i = 0; i < points.size(); ++i ) { if( points[i] == points[1] ) { expected.push_back( i ); } }
+    EXPECT_EQ( expected, map.find( points[1] ) );
+    points.push_back( Eigen::Vector3d( 50, -50, 5 ) ); // outside of the points so far: keys get computed again
+    points.push_back( Eigen::Vector3d( 50, -50, 5 ) );
+    map.insert( points.size() - 2 );
+    map.insert( points.size() - 1 );
+    map.erase( 1 ); // erasure after insertions
+    map.insert( 1 ); // and insertion after erasure
+    EXPECT_EQ( points.size(), map.size() );
+    EXPECT_EQ( 2u, map.find( Eigen::Vector3d( 50, -50, 5 ) ).size() );
+    EXPECT_EQ( expected, map.find( points[1] ) );
+    Collect collect;
+    map.find( Eigen::Vector3d( -100, -100, -100 ), Eigen::Vector3d( 100, 100, 100 ), collect );
+    EXPECT_EQ( points.size(), collect.indices.size() );
+    map.clear();
+    EXPECT_TRUE( map.empty() );
+    EXPECT_TRUE( map.find( points[1] ).empty() );
+}
+
+} // namespace snark {
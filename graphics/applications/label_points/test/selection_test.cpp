@@ -0,0 +1,188 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../Selection.h"
+
+namespace snark { namespace graphics { namespace View {
+
+typedef std::vector< bool > Model; // reference: one bool per record
+
+static std::vector< comma::uint32 > indices( const Model& model )
+{
+    std::vector< comma::uint32 > v;
+    for( std::size_t i = 0; i < model.size(); ++i ) { if( model[i] ) { v.push_back( i ); } }
+    return v;
+}
+
+static std::vector< comma::uint32 > sparse( std::size_t size, unsigned int blocks ) // random records in a few blocks of up to 100 records far apart, in random order
+{
+    std::vector< comma::uint32 > v;
+    for( unsigned int b = 0; b < blocks; ++b )
+    {
+        std::size_t begin = std::rand() % size;
+        std::size_t end = std::min( size, begin + 1 + std::rand() % 100 );
+        for( std::size_t i = begin; i < end; ++i ) { if( std::rand() % 3 ) { v.push_back( i ); } }
+    }
+    return v;
+}
+
+static void expect_equal( const Model& model, const Selection& selection )
+{
+    const std::vector< comma::uint32 > expected = indices( model );
+    EXPECT_EQ( expected, selection.indices() );
+    EXPECT_EQ( expected.size(), selection.size() );
+    EXPECT_EQ( expected.empty(), selection.empty() );
+    EXPECT_EQ( ( model.size() + 63 ) / 64, selection.words() );
+    std::size_t i = 0;
+    while( i < model.size() && model[i] == selection.contains( i ) ) { ++i; }
+    EXPECT_EQ( model.size(), i ) << "first record that differs";
+    if( model.size() % 64 ) { EXPECT_EQ( 0u, selection.word( selection.words() - 1 ) >> ( model.size() % 64 ) ); } // nothing past the last record
+}
+
+struct Odd { bool operator()( comma::uint32 index ) const { return index % 2 == 1; } };
+
+TEST( Partition, insert )
+{
+    std::srand( 1 );
+    std::size_t sizes[] = { 1, 63, 64, 65, 127, 129, 1000, 70000 };
+    for( std::size_t s = 0; s < sizeof( sizes ) / sizeof( sizes[0] ); ++s )
+    {
+        Model model( sizes[s], false );
+        Partition partition;
+        std::vector< comma::uint32 > v = sparse( sizes[s], 5 ); // blocks in random order, i.e. partly out of order
+        for( std::size_t i = 0; i < v.size(); ++i ) { partition.insert( v[i] ); model[ v[i] ] = true; }
+        if( !v.empty() ) { partition.insert( v[0] ); } // duplicate
+        partition.normalise();
+        EXPECT_EQ( indices( model ), partition.indices() ) << "size " << sizes[s];
+        EXPECT_EQ( indices( model ).size(), partition.size() );
+        const std::vector< Partition::Word >& words = partition.words();
+        for( std::size_t i = 0; i < words.size(); ++i )
+        {
+            EXPECT_NE( 0u, words[i].bits );
+            if( i > 0 ) { EXPECT_LT( words[ i - 1 ].index, words[i].index ); }
+        }
+        partition.keep( Odd() );
+        for( std::size_t i = 0; i < model.size(); i += 2 ) { model[i] = false; }
+        EXPECT_EQ( indices( model ), partition.indices() );
+        EXPECT_EQ( indices( model ).size(), partition.size() );
+        for( std::size_t i = 0; i < partition.words().size(); ++i ) { EXPECT_NE( 0u, partition.words()[i].bits ); } // emptied words dropped
+    }
+}
+
+TEST( Selection, against_model )
+{
+    std::srand( 2 );
+    std::size_t sizes[] = { 1, 63, 64, 65, 100, 127, 128, 129, 1000, 70000 };
+    for( std::size_t s = 0; s < sizeof( sizes ) / sizeof( sizes[0] ); ++s )
+    {
+        const std::size_t size = sizes[s];
+        Model model( size, false );
+        Selection selection( size );
+        expect_equal( model, selection );
+        for( unsigned int k = 0; k < 50; ++k )
+        {
+            std::vector< comma::uint32 > v = sparse( size, 1 + std::rand() % 4 );
+            bool insert = std::rand() % 2;
+            switch( std::rand() % 3 )
+            {
+                case 0: // indices as they are, sorted, since partitions are sorted
+                    std::sort( v.begin(), v.end() );
+                    if( insert ) { selection.insert( v ); } else { selection.erase( v ); }
+                    break;
+                case 1: // partition, word by word
+                {
+                    Partition partition;
+                    for( std::size_t i = 0; i < v.size(); ++i ) { partition.insert( v[i] ); }
+                    partition.normalise();
+                    if( insert ) { selection.insert( partition ); } else { selection.erase( partition ); }
+                    break;
+                }
+                case 2:
+                    if( std::rand() % 10 == 0 ) { selection.clear(); std::fill( model.begin(), model.end(), false ); }
+                    continue;
+            }
+            for( std::size_t i = 0; i < v.size(); ++i ) { model[ v[i] ] = insert; }
+            expect_equal( model, selection );
+            if( HasFailure() ) { FAIL() << "size " << size << ", step " << k; }
+        }
+    }
+}
+
+TEST( Selection, last_partial_word )
+{
+    const std::size_t size = 130; // last word holds records 128 and 129
+    Model model( size, false );
+    Selection selection( size );
+    Partition partition;
+    for( comma::uint32 i = 120; i < size; ++i ) { partition.insert( i ); model[i] = true; }
+    selection.insert( partition );
+    expect_equal( model, selection );
+    EXPECT_EQ( 3u, selection.word( 2 ) );
+    std::vector< comma::uint32 > last;
+    last.push_back( 128 );
+    last.push_back( 129 );
+    selection.erase( last );
+    model[128] = model[129] = false;
+    expect_equal( model, selection );
+    EXPECT_EQ( 0u, selection.word( 2 ) );
+    selection.insert( last );
+    model[128] = model[129] = true;
+    selection.erase( partition ); // whole partition, including the last word
+    std::fill( model.begin(), model.end(), false );
+    expect_equal( model, selection );
+    selection.insert( partition );
+    comma::uint64 version = selection.version();
+    selection.clear();
+    EXPECT_GT( selection.version(), version );
+    std::fill( model.begin(), model.end(), false );
+    expect_equal( model, selection );
+    version = selection.version();
+    selection.clear(); // nothing to clear
+    EXPECT_EQ( version, selection.version() );
+}
+
+TEST( Selection, sparse_blocks )
+{
+    const std::size_t size = 1000000;
+    Model model( size, false );
+    Selection selection( size );
+    Partition partition; // three blocks far apart, straddling word boundaries
+    comma::uint32 begins[] = { 60, 500030, 999990 };
+    for( unsigned int b = 0; b < 3; ++b ) { for( comma::uint32 i = begins[b]; i < std::min< comma::uint32 >( size, begins[b] + 10 ); ++i ) { partition.insert( i ); model[i] = true; } }
+    EXPECT_EQ( 5u, partition.words().size() ); // 60-69: 2 words, 500030-500039: 1 word, 999990-999999: 2 words
+    selection.insert( partition );
+    expect_equal( model, selection );
+    std::vector< comma::uint32 > some;
+    some.push_back( 61 );
+    some.push_back( 500035 );
+    some.push_back( 999999 );
+    selection.erase( some );
+    for( std::size_t i = 0; i < some.size(); ++i ) { model[ some[i] ] = false; }
+    expect_equal( model, selection );
+    selection.insert( partition ); // already selected records stay selected once
+    for( unsigned int b = 0; b < 3; ++b ) { for( comma::uint32 i = begins[b]; i < std::min< comma::uint32 >( size, begins[b] + 10 ); ++i ) { model[i] = true; } }
+    expect_equal( model, selection );
+    EXPECT_EQ( 30u, selection.size() );
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
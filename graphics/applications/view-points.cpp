@@ -24,6 +24,8 @@
 #include <comma/string/string.h>
 #include <snark/graphics/applications/view_points/MainWindow.h>
 #include <snark/graphics/applications/view_points/Viewer.h>
+#include <snark/graphics/applications/view_points/AsciiPointReader.h>
+#include <snark/graphics/applications/view_points/BinaryPointReader.h>
 #include <snark/graphics/applications/view_points/ShapeReader.h>
 #include <snark/graphics/applications/view_points/ModelReader.h>
 #include <snark/graphics/applications/view_points/TextureReader.h>
@@ -41,6 +43,14 @@ void usage()
     std::cerr << "<options>" << std::endl;
     std::cerr << "    --size <size> : render last <size> points (or other shapes)" << std::endl;
     std::cerr << "                    default 2000000 for points, for 200000 for other shapes" << std::endl;
+    std::cerr << "    --batch-size <size> : hand over points (or other shapes) to the viewer in batches of up to <size>; default 4096" << std::endl;
+    std::cerr << "    --queue-size <size> : keep up to <size> records read, but not yet handed over to the viewer" << std::endl;
+    std::cerr << "                          default: 262144 for points, 10000 for other shapes" << std::endl;
+    std::cerr << "                          memory: the queue is allocated up front and costs 20 to 32 bytes per point" << std::endl;
+    std::cerr << "                          or about 80 bytes per shape, plus labels longer than 15 characters" << std::endl;
+    std::cerr << "    --overflow <policy> : what to do, if the viewer does not keep up with the input and the queue is full" << std::endl;
+    std::cerr << "          <policy>: drop-oldest | drop-newest | block; default: block for regular files, drop-oldest otherwise" << std::endl;
+    std::cerr << "    --verbose,-v : output reading statistics (records/s) for each file or stream every 10 seconds and at its end" << std::endl;
     std::cerr << "    --background-colour <colour> : e.g. #ff0000, default: #000000 (black)" << std::endl;
     std::cerr << "    --camera=\"<options>\"" << std::endl;
     std::cerr << "          <options>: [<fov>];[<type>]" << std::endl;
@@ -81,6 +91,18 @@ void usage()
     std::cerr << "                     \"extents\": e.g. --shape=extents --fields=,,min,max,,," << std::endl;
     std::cerr << "                     \"line\": e.g. --shape=line --fields=,,first,second,,," << std::endl;
     std::cerr << "                     \"label\": e.g. --shape=label --fields=,x,y,z,,,label" << std::endl;
+    std::cerr << "    --quantise <resolution> : for points only: keep point coordinates in graphics memory as 16-bit integers" << std::endl;
+    std::cerr << "                              in units of <resolution> metres relative to the first point, e.g. --quantise=0.001" << std::endl;
+    std::cerr << "                              uses 12 instead of 16 bytes per point; once a point is further than 32767 * <resolution>," << std::endl;
+    std::cerr << "                              all the points of the file fall back to 16 bytes, without level of detail" << std::endl;
+    std::cerr << "    binary points with --fields=x,y,z and --binary=3d or 3f, --fields=x,y,z,id and --binary=3d,ui, or --fields=x,y,z,r,g,b and --binary=3d,3ub" << std::endl;
+    std::cerr << "    are read in blocks without parsing each record, which is considerably faster" << std::endl;
+    std::cerr << "    ascii point files (not stdin or pipes) with fields out of x,y,z,id,r,g,b,a,scalar are memory-mapped" << std::endl;
+    std::cerr << "    and parsed in parallel chunks, which is considerably faster; use --verbose to see the reading rate" << std::endl;
+    std::cerr << "    --point-budget <n> : for the fast point readers above: once the input is over, if there are more than <n> points," << std::endl;
+    std::cerr << "                         build level-of-detail octree and draw at most <n> points per frame, coarser further away" << std::endl;
+    std::cerr << "                         default: half of --size, thus files filling the buffer get drawn with level of detail;" << std::endl;
+    std::cerr << "                         0: always draw all the points; increase --size to see large files in full" << std::endl;
     std::cerr << "    --z-is-up : z-axis is pointing up, default: pointing down ( north-east-down system )" << std::endl;
     std::cerr << comma::csv::options::usage() << std::endl;
     std::cerr << std::endl;
@@ -122,6 +144,15 @@ boost::shared_ptr< snark::graphics::View::Reader > makeReader( QGLView& viewer
     comma::csv::options csv = csvOptions;
     std::string shape = options.value< std::string >( "--shape", "point" );
     std::size_t size = options.value< std::size_t >( "--size", shape == "point" ? 2000000 : 200000 );
+    std::size_t batchSize = options.value< std::size_t >( "--batch-size", 4096 );
+    bool verbose = options.exists( "--verbose,-v" );
+    std::size_t queueSize = options.value< std::size_t >( "--queue-size", 0 ); // 0: reader default
+    boost::optional< std::string > overflow;
+    if( options.exists( "--overflow" ) ) { overflow = options.value< std::string >( "--overflow" ); }
+    boost::optional< double > resolution;
+    if( options.exists( "--quantise" ) ) { resolution = options.value< double >( "--quantise" ); }
+    boost::optional< std::size_t > budget;
+    if( options.exists( "--point-budget" ) ) { budget = options.value< std::size_t >( "--point-budget" ); }
     unsigned int pointSize = options.value( "--point-size", 1u );
     std::string colour = options.exists( "--colour" ) ? options.value< std::string >( "--colour" ) : options.value< std::string >( "-c", "-10:10" );
     std::string label = options.value< std::string >( "--label", "" );
@@ -131,12 +162,20 @@ boost::shared_ptr< snark::graphics::View::Reader > makeReader( QGLView& viewer
         csv = nameValue.get( properties, csvOptions );
         comma::name_value::map m( properties, "filename", ';', '=' );
         size = m.value( "size", size );
+        batchSize = m.value( "batch-size", batchSize );
+        queueSize = m.value( "queue-size", queueSize );
+        if( m.exists( "overflow" ) ) { overflow = m.value< std::string >( "overflow", "" ); }
+        if( m.exists( "quantise" ) ) { resolution = m.value( "quantise", 0.001 ); }
+        if( m.exists( "point-budget" ) ) { budget = m.value< std::size_t >( "point-budget", 0 ); }
         pointSize = m.value( "point-size", pointSize );
         shape = m.value( "shape", shape );
         if( m.exists( "colour" ) ) { colour = m.value( "colour", colour ); }
         else if( m.exists( "color" ) ) { colour = m.value( "color", colour ); }
         label = m.value( "label", label );
     }
+    std::size_t pointBudget = budget ? *budget : size / 2; // by default, level of detail kicks in once the buffer is more than half full
+    if( !overflow ) { overflow = snark::graphics::mapped_file::mappable( csv.filename ) ? "block" : "drop-oldest"; } // do not drop anything from files by default
+    snark::graphics::ring_buffer_policy::values dropPolicy = snark::graphics::ring_buffer_policy::from_string( *overflow );
     snark::graphics::View::coloured* coloured = snark::graphics::View::colourFromString( colour, csv.fields, backgroundcolour );
     if( shape == "point" )
     {
@@ -144,7 +183,19 @@ boost::shared_ptr< snark::graphics::View::Reader > makeReader( QGLView& viewer
         std::vector< std::string > v = comma::split( csv.fields, ',' );
         bool has_orientation = false;
         for( unsigned int i = 0; !has_orientation && i < v.size(); ++i ) { has_orientation = v[i] == "roll" || v[i] == "pitch" || v[i] == "yaw"; }
-        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< Eigen::Vector3d >( viewer, csv, size, coloured, pointSize, label ) );
+        boost::optional< snark::graphics::View::BinaryPointFormat > binaryFormat = snark::graphics::View::BinaryPointFormat::from( csv );
+        if( binaryFormat ) // fast path for the most common binary formats
+        {
+            if( resolution ) { return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::BinaryPointReader< snark::graphics::qt3d::quantised_vertex >( viewer, csv, *binaryFormat, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy, pointBudget, *resolution ) ); }
+            return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::BinaryPointReader<>( viewer, csv, *binaryFormat, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy, pointBudget ) );
+        }
+        if( snark::graphics::View::AsciiPointReader<>::supports( csv ) ) // fast path for regular ascii files
+        {
+            if( resolution ) { return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::AsciiPointReader< snark::graphics::qt3d::quantised_vertex >( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy, pointBudget, *resolution ) ); }
+            return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::AsciiPointReader<>( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy, pointBudget ) );
+        }
+        if( resolution ) { return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< Eigen::Vector3d, snark::graphics::qt3d::quantised_vertex >( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy, *resolution ) ); }
+        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< Eigen::Vector3d >( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy ) );
     }
     if( shape == "label" )
     {
@@ -208,15 +259,15 @@ boost::shared_ptr< snark::graphics::View::Reader > makeReader( QGLView& viewer
     csv.full_xpath = true;
     if( shape == "extents" )
     {
-        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< snark::graphics::extents< Eigen::Vector3d > >( viewer, csv, size, coloured, pointSize, label ) );
+        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< snark::graphics::extents< Eigen::Vector3d > >( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy ) );
     }
     else if( shape == "line" )
     {
-        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< std::pair< Eigen::Vector3d, Eigen::Vector3d > >( viewer, csv, size, coloured, pointSize, label ) );
+        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< std::pair< Eigen::Vector3d, Eigen::Vector3d > >( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy ) );
     }
     else if( shape == "ellipse" )
     {
-        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< snark::graphics::View::Ellipse< 25 > >( viewer, csv, size, coloured, pointSize, label ) );
+        return boost::shared_ptr< snark::graphics::View::Reader >( new snark::graphics::View::ShapeReader< snark::graphics::View::Ellipse< 25 > >( viewer, csv, size, coloured, pointSize, label, batchSize, verbose, queueSize, dropPolicy ) );
     }
     COMMA_THROW( snark::graphics::exception, "expected shape, got \"" << shape << "\"" ); // never here
 }
@@ -228,8 +279,8 @@ int main( int argc, char** argv )
         comma::command_line_options options( argc, argv );
         if( options.exists( "--help" ) || options.exists( "-h" ) ) { usage(); }
         comma::csv::options csvOptions( argc, argv );
-        std::vector< std::string > properties = options.unnamed( "--z-is-up,--orthographic"
-                , "--binary,--bin,-b,--fields,--size,--delimiter,-d,--colour,-c,--point-size,--image-size,--background-colour,--shape,--label,--camera,--camera-position,--fov,--model,--full-xpath" );
+        std::vector< std::string > properties = options.unnamed( "--z-is-up,--orthographic,--verbose,-v"
+                , "--binary,--bin,-b,--fields,--size,--batch-size,--queue-size,--overflow,--quantise,--point-budget,--delimiter,-d,--colour,-c,--point-size,--image-size,--background-colour,--shape,--label,--camera,--camera-position,--fov,--model,--full-xpath" );
         QColor4ub backgroundcolour( QColor( QString( options.value< std::string >( "--background-colour", "#000000" ).c_str() ) ) );
         boost::optional< comma::csv::options > camera_csv; 
         boost::optional< Eigen::Vector3d > cameraposition;
@@ -0,0 +1,166 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_ASCII_POINT_READER_H_
+#define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_ASCII_POINT_READER_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <snark/graphics/impl/fast_ascii.h>
+#include <snark/graphics/impl/mapped_file.h>
+#include <snark/graphics/impl/parallel.h>
+#include "./PointBatchReader.h"
+
+namespace snark { namespace graphics { namespace View {
+
+/// fast reader for regular ascii files of points
+/// maps the file, splits it into chunks of whole lines, parses the chunks in parallel
+/// without lexical_cast or iostreams into coloured vertices and hands the batches over in file order
+template< typename V = qt3d::packed_vertex >
+class AsciiPointReader : public PointBatchReader< V >
+{
+    public:
+        /// return true, if the options describe a regular ascii file with nothing but point coordinates, id, colour or scalar
+        static bool supports( const comma::csv::options& options );
+
+        AsciiPointReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize = 4096, bool verbose = false, std::size_t queueSize = 0, ring_buffer_policy::values dropPolicy = ring_buffer_policy::block, std::size_t pointBudget = 0, float resolution = 0.001 );
+
+        void start();
+        bool readOnce();
+
+    private:
+        typedef typename PointBatchReader< V >::Batch Batch;
+        enum { x, y, z, id, r, g, b, a, scalar, slots };
+        static const char* names() { return "x,y,z,id,r,g,b,a,scalar"; }
+
+        struct Parsed
+        {
+            std::vector< Eigen::Vector3d > points; // until packed into the batch
+            std::vector< QColor4ub > colors;
+            Batch batch;
+        };
+
+        struct ParseChunk // parse one chunk of lines into its own batch
+        {
+            const fast_ascii* ascii;
+            const coloured* colored;
+            const std::vector< mapped_file::chunk >* chunks;
+            std::vector< Parsed >* parsed;
+            void operator()( std::size_t i ) const;
+        };
+
+        const fast_ascii m_ascii;
+        boost::scoped_ptr< mapped_file > m_file;
+        const char* m_position; // in mapped file
+        std::size_t m_window; // bytes to parse at once, grows with the length of lines
+        std::vector< Parsed > m_parsed; // one per thread
+};
+
+template< typename V >
+inline bool AsciiPointReader< V >::supports( const comma::csv::options& options )
+{
+    if( options.binary() || !mapped_file::mappable( options.filename ) ) { return false; }
+    fast_ascii ascii( options.fields, names(), options.delimiter );
+    return ascii.covers() && ascii.has( x ) && ascii.has( y ) && ascii.has( z );
+}
+
+template< typename V >
+AsciiPointReader< V >::AsciiPointReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize, bool verbose, std::size_t queueSize, ring_buffer_policy::values dropPolicy, std::size_t pointBudget, float resolution ):
+    PointBatchReader< V >( viewer, options, size, c, pointSize, label, batchSize, verbose, queueSize, dropPolicy, pointBudget, resolution ),
+    m_ascii( options.fields, names(), options.delimiter ),
+    m_position( NULL ),
+    m_window( 0 ),
+    m_parsed( parallel_threads() )
+{
+}
+
+template< typename V >
+inline void AsciiPointReader< V >::start()
+{
+    m_file.reset( new mapped_file( this->options.filename ) );
+    m_position = m_file->data();
+    m_window = m_parsed.size() * this->m_batchSize * 16; // a first guess of 16 bytes per line; grows, if lines are longer
+    PointBatchReader< V >::start();
+}
+
+template< typename V >
+inline void AsciiPointReader< V >::ParseChunk::operator()( std::size_t i ) const
+{
+    Parsed& p = ( *parsed )[i];
+    Batch& batch = p.batch;
+    p.points.clear(); // reused, hence no reallocation after the first few windows
+    p.colors.clear();
+    batch.vertices.clear();
+    batch.ids.clear();
+    batch.scalars.clear();
+    const char* begin = ( *chunks )[i].first;
+    const char* end = ( *chunks )[i].second;
+    for( mapped_file::chunk line; mapped_file::next_line( begin, end, line ); )
+    {
+        double values[ slots ] = { 0, 0, 0, 0, 0, 0, 0, 255, 0 };
+        ascii->get( line.first, line.second, values );
+        p.points.push_back( Eigen::Vector3d( values[x], values[y], values[z] ) );
+        p.colors.push_back( QColor4ub( static_cast< int >( values[r] ), static_cast< int >( values[g] ), static_cast< int >( values[b] ), static_cast< int >( values[a] ) ) );
+        if( ascii->has( id ) ) { batch.ids.push_back( comma::uint32( values[id] ) ); }
+        if( ascii->has( scalar ) ) { batch.scalars.push_back( values[scalar] ); }
+    }
+    if( !p.points.empty() ) { batch.pack( p.points, p.colors, *colored ); }
+}
+
+template< typename V >
+inline bool AsciiPointReader< V >::readOnce()
+{
+    try
+    {
+        const char* end = m_file->data() + m_file->size();
+        if( m_position == end )
+        {
+            this->finish();
+            return false;
+        }
+        const char* windowEnd = std::size_t( end - m_position ) > m_window ? m_position + m_window : end;
+        while( windowEnd > m_position && windowEnd < end && *( windowEnd - 1 ) != '\n' ) { --windowEnd; } // back to the end of the last whole line
+        if( windowEnd == m_position ) { m_window *= 2; return true; } // a line does not fit into the window: grow it and try again
+        std::vector< mapped_file::chunk > chunks = mapped_file::lines( m_position, windowEnd, m_parsed.size() );
+        ParseChunk parse = { &m_ascii, this->m_colored.get(), &chunks, &m_parsed };
+        parallel_for( chunks.size(), parse );
+        std::size_t lines = 0;
+        for( std::size_t i = 0; i < chunks.size(); ++i ) { lines += m_parsed[i].batch.vertices.size(); }
+        if( lines > 0 ) { m_window = std::max( m_window, std::size_t( windowEnd - m_position ) / lines * m_parsed.size() * this->m_batchSize ); } // a batch per thread of lines as long as these
+        m_position = windowEnd;
+        for( std::size_t i = 0; i < chunks.size(); ++i ) // hand over in file order
+        {
+            if( m_parsed[i].batch.vertices.empty() ) { continue; }
+            this->m_count += m_parsed[i].batch.vertices.size();
+            Batch* batch = this->m_ring.reserve();
+            if( batch == NULL ) { if( this->m_shutdown ) { return false; } continue; }
+            batch->swap( m_parsed[i].batch );
+            this->publish( *batch );
+        }
+        return true;
+    }
+    catch( std::exception& ex ) { std::cerr << "view-points: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "view-points: unknown exception" << std::endl; }
+    return false;
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif // SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_ASCII_POINT_READER_H_
@@ -0,0 +1,203 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_BINARY_POINT_READER_H_
+#define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_BINARY_POINT_READER_H_
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <comma/base/types.h>
+#include <snark/graphics/impl/block_reader.h>
+#include <snark/graphics/impl/mapped_file.h>
+#include "./PointBatchReader.h"
+
+namespace snark { namespace graphics { namespace View {
+
+/// binary point record layouts read without csv visiting: 3d, 3d,ui, 3d,3ub and 3f
+struct BinaryPointFormat
+{
+    std::size_t size; // record size in bytes
+    bool floats; // coordinates as floats rather than doubles
+    int id; // offset of id in the record, -1 if absent
+    int rgb; // offset of r,g,b in the record, -1 if absent
+
+    /// return layout, if options are binary with one of the supported formats and matching fields
+    static boost::optional< BinaryPointFormat > from( const comma::csv::options& options );
+};
+
+/// fast reader for binary point streams
+/// reads records in blocks of whatever is available into a raw buffer and decodes them in tight loops over arrays,
+/// which the compiler can vectorise, without building ShapeWithId (and its label string) per record,
+/// straight into coloured vertices, all on the reader thread
+/// regular files get memory-mapped and decoded straight from the mapping
+template< typename V = qt3d::packed_vertex >
+class BinaryPointReader : public PointBatchReader< V >
+{
+    public:
+        BinaryPointReader( QGLView& viewer, comma::csv::options& options, const BinaryPointFormat& format, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize = 4096, bool verbose = false, std::size_t queueSize = 0, ring_buffer_policy::values dropPolicy = ring_buffer_policy::drop_oldest, std::size_t pointBudget = 0, float resolution = 0.001 );
+
+        void start();
+        bool readOnce();
+
+    private:
+        typedef typename PointBatchReader< V >::Batch Batch;
+        std::size_t readBlock( const char*& records );
+        std::size_t mapBlock( const char*& records );
+        void decode( const char* records, std::size_t count, Batch& batch );
+        const BinaryPointFormat m_format;
+        boost::scoped_ptr< block_reader > m_reader; // for streams
+        std::vector< Eigen::Vector3d > m_points; // decoded, until packed into the batch
+        std::vector< QColor4ub > m_colors;
+        boost::scoped_ptr< mapped_file > m_file;
+        std::size_t m_position; // in mapped file
+};
+
+inline boost::optional< BinaryPointFormat > BinaryPointFormat::from( const comma::csv::options& options )
+{
+    if( !options.binary() ) { return boost::none; }
+    static const char* formats[][5] = { { "x,y,z", "3d", "d,d,d", NULL, NULL }
+                                       , { "x,y,z,id", "3d,ui", "d,d,d,ui", NULL, NULL }
+                                       , { "x,y,z,r,g,b", "3d,3ub", "d,d,d,ub,ub,ub", "3d,ub,ub,ub", "d,d,d,3ub" }
+                                       , { "x,y,z", "3f", "f,f,f", NULL, NULL } };
+    const std::string& format = options.format().string();
+    for( unsigned int i = 0; i < 4; ++i )
+    {
+        if( options.fields != formats[i][0] ) { continue; }
+        for( unsigned int j = 1; j < 5 && formats[i][j] != NULL; ++j )
+        {
+            if( format != comma::csv::format( formats[i][j] ).string() ) { continue; }
+            BinaryPointFormat f;
+            f.floats = i == 3;
+            f.size = f.floats ? 12 : 24;
+            f.id = i == 1 ? int( f.size ) : -1;
+            f.rgb = i == 2 ? int( f.size ) : -1;
+            f.size += i == 1 ? 4 : i == 2 ? 3 : 0;
+            return f;
+        }
+    }
+    return boost::none;
+}
+
+template< typename V >
+BinaryPointReader< V >::BinaryPointReader( QGLView& viewer, comma::csv::options& options, const BinaryPointFormat& format, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize, bool verbose, std::size_t queueSize, ring_buffer_policy::values dropPolicy, std::size_t pointBudget, float resolution ):
+    PointBatchReader< V >( viewer, options, size, c, pointSize, label, batchSize, verbose, queueSize, dropPolicy, pointBudget, resolution ),
+    m_format( format ),
+    m_position( 0 )
+{
+}
+
+template< typename V >
+inline void BinaryPointReader< V >::start()
+{
+    if( mapped_file::mappable( this->options.filename ) ) { m_file.reset( new mapped_file( this->options.filename ) ); }
+    PointBatchReader< V >::start();
+}
+
+template< typename V >
+inline std::size_t BinaryPointReader< V >::readBlock( const char*& records ) // return number of whole records read; 0, if none arrived for a while or at the end of stream
+{
+    if( !m_reader ) { m_reader.reset( new block_reader( this->m_istream.fd(), m_format.size, this->m_batchSize ) ); } // the stream may get opened after start(), e.g. a named pipe
+    std::size_t count = m_reader->read( boost::posix_time::milliseconds( 100 ) ); // wake up now and then to check for shutdown
+    records = m_reader->data();
+    return count;
+}
+
+template< typename V >
+inline std::size_t BinaryPointReader< V >::mapBlock( const char*& records ) // return number of records available in the mapping
+{
+    std::size_t count = ( m_file->size() - m_position ) / m_format.size;
+    if( count > this->m_batchSize ) { count = this->m_batchSize; }
+    records = m_file->data() + m_position;
+    m_position += count * m_format.size;
+    return count;
+}
+
+template< typename V >
+inline void BinaryPointReader< V >::decode( const char* records, std::size_t count, Batch& batch )
+{
+    m_points.resize( count ); // reused, hence no reallocation after the first batch
+    m_colors.resize( count );
+    batch.ids.resize( m_format.id >= 0 ? count : 0 );
+    if( m_format.floats )
+    {
+        for( std::size_t i = 0; i < count; ++i )
+        {
+            float p[3];
+            std::memcpy( p, records + i * m_format.size, sizeof( p ) );
+            m_points[i] = Eigen::Vector3d( p[0], p[1], p[2] );
+        }
+    }
+    else
+    {
+        for( std::size_t i = 0; i < count; ++i ) { std::memcpy( m_points[i].data(), records + i * m_format.size, 3 * sizeof( double ) ); }
+    }
+    if( m_format.id >= 0 )
+    {
+        for( std::size_t i = 0; i < count; ++i ) { std::memcpy( &batch.ids[i], records + i * m_format.size + m_format.id, sizeof( comma::uint32 ) ); }
+    }
+    if( m_format.rgb >= 0 )
+    {
+        for( std::size_t i = 0; i < count; ++i ) { const unsigned char* c = reinterpret_cast< const unsigned char* >( records + i * m_format.size + m_format.rgb ); m_colors[i] = QColor4ub( c[0], c[1], c[2] ); }
+    }
+    else
+    {
+        std::fill( m_colors.begin(), m_colors.end(), QColor4ub() );
+    }
+    batch.pack( m_points, m_colors, *this->m_colored );
+}
+
+template< typename V >
+inline bool BinaryPointReader< V >::readOnce()
+{
+    try
+    {
+        if( !m_file && !this->m_istream() ) // quick and dirty: handle named pipes
+        {
+#ifndef WIN32
+            // HACK poll on blocking pipe
+            ::usleep( 1000 );
+#endif
+            return true;
+        }
+        const char* records = NULL;
+        std::size_t count = m_file ? mapBlock( records ) : readBlock( records );
+        if( count == 0 )
+        {
+            if( !m_file && !m_reader->eof() ) { return true; } // nothing arrived yet
+            this->finish();
+            return false;
+        }
+        this->m_count += count;
+        Batch* batch = this->m_ring.reserve();
+        if( batch == NULL ) { return !this->m_shutdown; }
+        decode( records, count, *batch );
+        this->publish( *batch );
+        return true;
+    }
+    catch( std::exception& ex ) { std::cerr << "view-points: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "view-points: unknown exception" << std::endl; }
+    return false;
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif // SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_BINARY_POINT_READER_H_
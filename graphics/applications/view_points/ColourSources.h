@@ -0,0 +1,163 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_COLOUR_SOURCES_H_
+#define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_COLOUR_SOURCES_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <comma/base/types.h>
+#include <comma/string/string.h>
+#include <snark/graphics/impl/parallel.h>
+#include <snark/graphics/qt3d/vertex_buffer.h>
+#include "./Coloured.h"
+
+namespace snark { namespace graphics { namespace View {
+
+/// what the shapes in a vertex buffer have been coloured from, to colour them again with a different
+/// colour map without reading them again: id and scalar, only if present in the fields, and the
+/// colour the shape has been read with; kept by shape, i.e. by vertex index divided by vertices per shape;
+/// the centre of a shape, which colour maps by height use, is the mean of its vertices
+class ColourSources
+{
+    public:
+        /// @param fields input fields
+        /// @param shape number of vertices per shape
+        ColourSources( const std::string& fields = "", unsigned int shape = 1 );
+
+        /// keep sources of the shape whose first vertex has the given index in the vertex buffer
+        void set( unsigned int index, comma::uint32 id, double scalar, const QColor4ub& color );
+
+        /// reorder after vertices [first, first + permutation.size()) of the vertex buffer got reordered
+        /// into [0, permutation.size()), i-th vertex coming from first + permutation[i]; shape size 1 only
+        void reorder( const std::vector< unsigned int >& permutation, unsigned int first );
+
+        /// colour all the shapes in the buffer again, in parallel
+        /// @param offset subtracted from the shapes when they were added to the buffer
+        template < typename V >
+        void recolor( const coloured& c, qt3d::basic_vertex_buffer< V >& buffer, const Eigen::Vector3d& offset ) const;
+
+    private:
+        template < typename V > struct Recolor;
+        unsigned int m_shape;
+        bool m_hasIds;
+        bool m_hasScalars;
+        std::vector< QColor4ub > m_colors;
+        std::vector< comma::uint32 > m_ids; // empty, if no id field
+        std::vector< double > m_scalars; // empty, if no scalar field; double as read, since colour maps by scalar take double
+};
+
+inline ColourSources::ColourSources( const std::string& fields, unsigned int shape )
+    : m_shape( shape )
+    , m_hasIds( false )
+    , m_hasScalars( false )
+{
+    std::vector< std::string > v = comma::split( fields, ',' );
+    for( std::size_t i = 0; i < v.size(); ++i )
+    {
+        if( v[i] == "id" ) { m_hasIds = true; }
+        if( v[i] == "scalar" ) { m_hasScalars = true; }
+    }
+}
+
+inline void ColourSources::set( unsigned int index, comma::uint32 id, double scalar, const QColor4ub& color )
+{
+    unsigned int i = index / m_shape;
+    if( i >= m_colors.size() ) // once per buffer, or once more, if the second half of a double buffer has been allocated
+    {
+        m_colors.resize( i + 1 );
+        if( m_hasIds ) { m_ids.resize( i + 1 ); }
+        if( m_hasScalars ) { m_scalars.resize( i + 1 ); }
+    }
+    m_colors[i] = color;
+    if( m_hasIds ) { m_ids[i] = id; }
+    if( m_hasScalars ) { m_scalars[i] = scalar; }
+}
+
+inline void ColourSources::reorder( const std::vector< unsigned int >& permutation, unsigned int first )
+{
+    std::vector< QColor4ub > colors( permutation.size() );
+    for( std::size_t i = 0; i < permutation.size(); ++i ) { colors[i] = m_colors[ first + permutation[i] ]; }
+    m_colors.swap( colors );
+    if( m_hasIds )
+    {
+        std::vector< comma::uint32 > ids( permutation.size() );
+        for( std::size_t i = 0; i < permutation.size(); ++i ) { ids[i] = m_ids[ first + permutation[i] ]; }
+        m_ids.swap( ids );
+    }
+    if( m_hasScalars )
+    {
+        std::vector< double > scalars( permutation.size() );
+        for( std::size_t i = 0; i < permutation.size(); ++i ) { scalars[i] = m_scalars[ first + permutation[i] ]; }
+        m_scalars.swap( scalars );
+    }
+}
+
+template < typename V >
+struct ColourSources::Recolor // colour shapes [ size * i / threads, size * ( i + 1 ) / threads )
+{
+    enum { block = 256 };
+    const ColourSources* sources;
+    const coloured* colored;
+    qt3d::basic_vertex_buffer< V >* buffer;
+    Eigen::Vector3d offset;
+    std::size_t size;
+    std::size_t threads;
+
+    void operator()( std::size_t i ) const
+    {
+        const unsigned int shape = sources->m_shape;
+        Eigen::Vector3d points[ block ];
+        QColor4ub colors[ block ];
+        std::size_t end = size * ( i + 1 ) / threads;
+        for( std::size_t begin = size * i / threads; begin < end; begin += block )
+        {
+            std::size_t n = std::min< std::size_t >( block, end - begin );
+            for( std::size_t j = 0; j < n; ++j )
+            {
+                QVector3D p;
+                for( unsigned int k = 0; k < shape; ++k ) { p += buffer->position( ( begin + j ) * shape + k ); }
+                p /= shape;
+                points[j] = Eigen::Vector3d( p.x(), p.y(), p.z() ) + offset;
+                colors[j] = sources->m_colors[ begin + j ];
+            }
+            colored->color_batch( points, sources->m_hasIds ? &sources->m_ids[ begin ] : NULL, sources->m_hasScalars ? &sources->m_scalars[ begin ] : NULL, colors, n );
+            for( std::size_t j = 0; j < n; ++j )
+            {
+                for( unsigned int k = 0; k < shape; ++k ) { buffer->setColor( ( begin + j ) * shape + k, colors[j] ); }
+            }
+        }
+    }
+};
+
+template < typename V >
+inline void ColourSources::recolor( const coloured& c, qt3d::basic_vertex_buffer< V >& buffer, const Eigen::Vector3d& offset ) const
+{
+    std::size_t size = std::min< std::size_t >( m_colors.size(), buffer.allocated() / m_shape );
+    if( size == 0 ) { return; }
+    buffer.detach(); // vertices may still be shared, e.g. with the octree reordering them; setColor() from several threads would copy them concurrently
+    Recolor< V > r = { this, &c, &buffer, offset, size, std::min< std::size_t >( parallel_threads(), ( size + Recolor< V >::block - 1 ) / Recolor< V >::block ) };
+    parallel_for( r.threads, r );
+    buffer.markDirty( 0, size * m_shape );
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif // SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_COLOUR_SOURCES_H_
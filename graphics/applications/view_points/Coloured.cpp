@@ -73,11 +73,65 @@ static QColor4ub add( const QColor4ub& a, const QColor4ub& b )
     return QColor4ub( red, green, blue, alpha );
 }
 
+enum { batchBlock = 256 }; // values looked up per pass in color_batch(), small enough to stay on the stack
+
+void coloured::color_batch( const Eigen::Vector3d* points, const comma::uint32* ids, const double* scalars, QColor4ub* colors, std::size_t size ) const
+{
+    for( std::size_t i = 0; i < size; ++i ) { colors[i] = color( points[i], ids == NULL ? 0 : ids[i], scalars == NULL ? 0 : scalars[i], colors[i] ); }
+}
+
 
 Fixed::Fixed( const std::string& name ) : m_color( color_from_name( name ) ) {}
 
 QColor4ub Fixed::color( const Eigen::Vector3d&, comma::uint32, double, const QColor4ub& ) const { return m_color; }
 
+void Fixed::color_batch( const Eigen::Vector3d*, const comma::uint32*, const double*, QColor4ub* colors, std::size_t size ) const { std::fill( colors, colors + size, m_color ); }
+
+/// colour at height normalised to [0, 1]
+static QColor4ub heightColor( const ByHeight& h, double v )
+{
+    if( h.cyclic )
+    {
+        if( h.sharp ) { return v < h.middle ? h.from_color : h.to_color; }
+        if( h.linear )
+        {
+            if( v < h.middle * 0.5 )
+            {
+                return add( multiply( h.average_color, 1 - v ), multiply( h.from_color, v ) );
+            }
+            else if( v < ( 1 + h.middle ) * 0.5 )
+            {
+                v = v - h.middle * 0.5;
+                return add( multiply( h.from_color, ( 1 - v ) ), multiply( h.to_color, v ) );
+            }
+            else
+            {
+                v = v - ( 1 + h.middle ) * 0.5;
+                return add( multiply( h.to_color, 1 - v ), multiply( h.average_color, v ) );
+            }
+        }
+        else
+        {
+            if( v < h.middle )
+            {
+                v = v / h.middle - 0.5;
+                v = v * v * 4;
+                return add( multiply( h.from_color, 1 - v ), multiply( h.average_color, v ) );
+            }
+            else
+            {
+                v = ( v - h.middle ) / ( 1 - h.middle ) - 0.5;
+                v = v * v * 4;
+                return add( multiply( h.average_color, v ), multiply( h.to_color, 1 - v ) );
+            }
+        }
+    }
+    else
+    {
+        return add( multiply( h.from_color, v ), multiply( h.to_color, 1 - v ) );
+    }
+}
+
 ByHeight::ByHeight( double from
                   , double to
                   , const QColor4ub& from_color
@@ -100,63 +154,60 @@ ByHeight::ByHeight( double from
     average_color.setGreen( ( from_color.green() / 2 ) + ( to_color.green() / 2 ) );
     average_color.setBlue( ( from_color.blue() / 2 ) + ( to_color.blue() / 2 ) );
     average_color.setAlpha( ( from_color.alpha() / 2 ) + ( to_color.alpha() / 2 ) );
+    for( std::size_t i = 0; i < ColourTable::size; ++i ) { table[i] = heightColor( *this, double( i ) / ( ColourTable::size - 1 ) ); }
+}
+
+float ByHeight::value( double z ) const
+{
+    if( !cyclic ) { return ( z - from ) / diff; }
+    double v = z / sum;
+    return v - std::floor( v );
 }
 
 QColor4ub ByHeight::color( const Eigen::Vector3d& point, comma::uint32, double, const QColor4ub& ) const
 {
-    if( cyclic )
+    float v = value( point.z() );
+    if( cyclic && sharp ) { return v < middle ? from_color : to_color; } // exact edge rather than nearest table entry
+    return table( v );
+}
+
+void ByHeight::color_batch( const Eigen::Vector3d* points, const comma::uint32*, const double*, QColor4ub* colors, std::size_t size ) const
+{
+    float v[ batchBlock ];
+    for( std::size_t begin = 0; begin < size; begin += batchBlock )
     {
-        double v = std::fmod( point.z() - std::floor( point.z() / sum ) * sum, sum ) / sum;
-        if( sharp ) { return v < middle ? from_color : to_color; }
-        if( linear )
-        {
-            if( v < middle * 0.5 )
-            {
-                return add( multiply( average_color, 1 - v ), multiply( from_color, v ) );
-            }
-            else if( v < ( 1 + middle ) * 0.5 )
-            {
-                v = v - middle * 0.5;
-                return add( multiply( from_color, ( 1 - v ) ), multiply( to_color, v ) );
-            }
-            else
-            {
-                v = v - ( 1 + middle ) * 0.5;
-                return add( multiply( to_color, 1 - v ), multiply( average_color, v ) );
-            }
-        }
-        else
-        {
-            if( v < middle )
-            {
-                v = v / middle - 0.5;
-                v = v * v * 4;
-                return add( multiply( from_color, 1 - v ), multiply( average_color, v ) );
-            }
-            else
-            {
-                v = ( v - middle ) / ( 1 - middle ) - 0.5;
-                v = v * v * 4;
-                return add( multiply( average_color, v ), multiply( to_color, 1 - v ) );
-            }
-        }
+        std::size_t n = std::min< std::size_t >( batchBlock, size - begin );
+        for( std::size_t i = 0; i < n; ++i ) { v[i] = value( points[ begin + i ].z() ); }
+        if( cyclic && sharp ) { for( std::size_t i = 0; i < n; ++i ) { colors[ begin + i ] = v[i] < middle ? from_color : to_color; } }
+        else { table( v, n, colors + begin ); }
     }
-    else
+}
+
+ByScalar::ByScalar( double from, double to, const QColor4ub& from_color, const QColor4ub& to_color )
+    : from( from ), to( to ), diff( to - from ), from_color( from_color ), to_color( to_color )
+{
+    for( std::size_t i = 0; i < ColourTable::size; ++i )
     {
-        double v = ( point.z() - from ) / diff;
-        v = ( v < 0 ? 0 : v > 1 ? 1 : v );
-        return add( multiply( from_color, v ), multiply( to_color, 1 - v ) );
+        double v = double( i ) / ( ColourTable::size - 1 );
+        table[i] = add( multiply( from_color, 1 - v ), multiply( to_color, v ) );
     }
 }
 
-ByScalar::ByScalar( double from, double to, const QColor4ub& from_color, const QColor4ub& to_color )
-    : from( from ), to( to ), diff( to - from ), from_color( from_color ), to_color( to_color ) {}
-QColor4ub ByScalar::color( const Eigen::Vector3d& point, comma::uint32, double scalar, const QColor4ub& ) const
+QColor4ub ByScalar::color( const Eigen::Vector3d&, comma::uint32, double scalar, const QColor4ub& ) const
 {
-    (void)point;
-    double v = ( scalar - from ) / diff;
-    v = ( v < 0 ? 0 : v > 1 ? 1 : v );
-    return add( multiply( from_color, 1 - v ), multiply( to_color, v ) );
+    return table( ( scalar - from ) / diff );
+}
+
+void ByScalar::color_batch( const Eigen::Vector3d* points, const comma::uint32* ids, const double* scalars, QColor4ub* colors, std::size_t size ) const
+{
+    if( scalars == NULL ) { coloured::color_batch( points, ids, scalars, colors, size ); return; }
+    float v[ batchBlock ];
+    for( std::size_t begin = 0; begin < size; begin += batchBlock )
+    {
+        std::size_t n = std::min< std::size_t >( batchBlock, size - begin );
+        for( std::size_t i = 0; i < n; ++i ) { v[i] = ( scalars[ begin + i ] - from ) / diff; }
+        table( v, n, colors + begin );
+    }
 }
 
 namespace impl {
@@ -177,6 +228,7 @@ ById::ById( const QColor4ub& backgroundcolour )
     : m_background( backgroundcolour )
     , m_hasScalar( false )
 {
+    init();
 }
     
 ById::ById( const QColor4ub& backgroundcolour
@@ -187,35 +239,52 @@ ById::ById( const QColor4ub& backgroundcolour
     , m_from( from )
     , m_diff( to - from )
 {
+    init();
 }
 
-QColor4ub ById::color( const Eigen::Vector3d&, comma::uint32 id, double scalar, const QColor4ub& ) const // quick and dirty
+void ById::init() // quick and dirty
 {
     static const float b = 0.95f;
-    unsigned char i = ( id & 0xff ) + ( ( id & 0xff00 ) >> 16 );
-    const float h = b * float( impl::colorIndices[ i ] ) / 255;
-    const float a = 0.3f * float( 255 - impl::colorIndices[ i ] ) / 255;
-    QColor4ub color;
-    switch( ( i * 13 + impl::colorIndex ) % 6 )
+    for( unsigned int i = 0; i < m_colors.size(); ++i )
     {
-        case 0 : color = QColor4ub::fromRgbF( b, h, a ); break;
-        case 1 : color = QColor4ub::fromRgbF( a, b, h ); break;
-        case 2 : color = QColor4ub::fromRgbF( h, a, b ); break;
-        case 3 : color = QColor4ub::fromRgbF( b, a, h ); break;
-        case 4 : color = QColor4ub::fromRgbF( h, b, a ); break;
-        default: color = QColor4ub::fromRgbF( a, h, b ); break;
+        const float h = b * float( impl::colorIndices[ i ] ) / 255;
+        const float a = 0.3f * float( 255 - impl::colorIndices[ i ] ) / 255;
+        switch( ( i * 13 + impl::colorIndex ) % 6 )
+        {
+            case 0 : m_colors[i] = QColor4ub::fromRgbF( b, h, a ); break;
+            case 1 : m_colors[i] = QColor4ub::fromRgbF( a, b, h ); break;
+            case 2 : m_colors[i] = QColor4ub::fromRgbF( h, a, b ); break;
+            case 3 : m_colors[i] = QColor4ub::fromRgbF( b, a, h ); break;
+            case 4 : m_colors[i] = QColor4ub::fromRgbF( h, b, a ); break;
+            default: m_colors[i] = QColor4ub::fromRgbF( a, h, b ); break;
+        }
     }
+}
+
+static unsigned char idIndex( comma::uint32 id ) { return ( id & 0xff ) + ( ( id & 0xff00 ) >> 16 ); }
+
+QColor4ub ById::color( const Eigen::Vector3d&, comma::uint32 id, double scalar, const QColor4ub& ) const
+{
+    const QColor4ub& color = m_colors[ idIndex( id ) ];
     if( !m_hasScalar ) { return color; }
     double v = ( scalar - m_from ) / m_diff;
     v = ( v < 0 ? 0 : v > 1 ? 1 : v );
     return add( multiply( color, v ), multiply( m_background, 1 - v ) );
 }
 
+void ById::color_batch( const Eigen::Vector3d* points, const comma::uint32* ids, const double* scalars, QColor4ub* colors, std::size_t size ) const
+{
+    if( m_hasScalar || ids == NULL ) { coloured::color_batch( points, ids, scalars, colors, size ); return; }
+    for( std::size_t i = 0; i < size; ++i ) { colors[i] = m_colors[ idIndex( ids[i] ) ]; }
+}
+
 QColor4ub ByRGB::color( const Eigen::Vector3d& , comma::uint32, double, const QColor4ub& c ) const
 {
     return c;
 }
 
+void ByRGB::color_batch( const Eigen::Vector3d*, const comma::uint32*, const double*, QColor4ub*, std::size_t ) const {} // colours are already there
+
 coloured* colourFromString( const std::string& s, const std::string& fields, const QColor4ub& backgroundcolour )
 {
     std::vector< std::string > f = comma::split( fields, ',' );
@@ -19,7 +19,9 @@
 #ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_COLOURED_H_
 #define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_COLOURED_H_
 
+#include <cstddef>
 #include <string>
+#include <boost/array.hpp>
 #include <Qt3D/qcolor4ub.h>
 #include "./PointWithId.h"
 
@@ -33,6 +35,36 @@ struct coloured
                              , double scalar
                              , const QColor4ub& c ) const = 0;
 
+    /// colour points in bulk, e.g. a decoded batch of records, in one virtual call
+    /// by default, calls color() for each point; subclasses override it with tight loops
+    /// @param ids, scalars NULL, if absent, same as all 0
+    /// @param colors input colours of the points, replaced with the result
+    virtual void color_batch( const Eigen::Vector3d* points
+                            , const comma::uint32* ids
+                            , const double* scalars
+                            , QColor4ub* colors
+                            , std::size_t size ) const;
+};
+
+/// colour map over [0, 1] precomputed at evenly spaced values,
+/// so that colouring a value costs a multiplication and a lookup
+class ColourTable
+{
+    public:
+        enum { size = 4096 };
+
+        /// colour at i-th value, i.e. at i / ( size - 1 ); fill all of them before use
+        QColor4ub& operator[]( std::size_t i ) { return m_colors[i]; }
+
+        /// return colour at nearest value; values outside of [0, 1] are clamped, nan gives colour at 0
+        QColor4ub operator()( float v ) const { return m_colors[ index( v ) ]; }
+
+        /// colour values in bulk
+        void operator()( const float* v, std::size_t n, QColor4ub* colors ) const { for( std::size_t i = 0; i < n; ++i ) { colors[i] = m_colors[ index( v[i] ) ]; } }
+
+    private:
+        static std::size_t index( float v ) { return v > 0 ? ( v < 1 ? int( v * ( size - 1 ) + 0.5f ) : size - 1 ) : 0; }
+        boost::array< QColor4ub, size > m_colors;
 };
 
 class Fixed : public coloured
@@ -43,6 +75,11 @@ class Fixed : public coloured
                          , comma::uint32 id
                          , double scalar
                          , const QColor4ub& c ) const;
+        void color_batch( const Eigen::Vector3d* points
+                          , const comma::uint32* ids
+                          , const double* scalars
+                          , QColor4ub* colors
+                          , std::size_t size ) const;
 
     private:
         QColor4ub m_color;
@@ -61,11 +98,20 @@ struct ByHeight : public coloured // todo: refactor and merge with byscalar
     double from, to, sum, diff, middle;
     QColor4ub from_color, to_color, average_color;
     bool cyclic, linear, sharp;
+    ColourTable table; // over height normalised by value()
     
+    /// return height normalised to [0, 1], to look up in table
+    float value( double z ) const;
+
     QColor4ub color( const Eigen::Vector3d& point
                      , comma::uint32 id
                      , double scalar
                      , const QColor4ub& c ) const;
+    void color_batch( const Eigen::Vector3d* points
+                      , const comma::uint32* ids
+                      , const double* scalars
+                      , QColor4ub* colors
+                      , std::size_t size ) const;
 };
 
 struct ByScalar : public coloured
@@ -77,10 +123,16 @@ struct ByScalar : public coloured
     double from, to, diff;
     QColor4ub from_color;
     QColor4ub to_color;
+    ColourTable table; // over ( scalar - from ) / diff
     QColor4ub color( const Eigen::Vector3d& point
                      , comma::uint32 id
                      , double scalar
                      , const QColor4ub& c ) const;
+    void color_batch( const Eigen::Vector3d* points
+                      , const comma::uint32* ids
+                      , const double* scalars
+                      , QColor4ub* colors
+                      , std::size_t size ) const;
 };
 
 class ById : public coloured
@@ -95,11 +147,18 @@ class ById : public coloured
                          , comma::uint32 id
                          , double scalar
                          , const QColor4ub& c ) const;
+        void color_batch( const Eigen::Vector3d* points
+                          , const comma::uint32* ids
+                          , const double* scalars
+                          , QColor4ub* colors
+                          , std::size_t size ) const;
     private:
+        void init();
         const QColor4ub m_background;
         bool m_hasScalar;
         double m_from;
         double m_diff;
+        boost::array< QColor4ub, 256 > m_colors; // by lower byte of id
 };
 
 struct ByRGB : public coloured
@@ -108,6 +167,11 @@ struct ByRGB : public coloured
                      , comma::uint32 id
                      , double scalar
                      , const QColor4ub& c ) const;
+    void color_batch( const Eigen::Vector3d* points
+                      , const comma::uint32* ids
+                      , const double* scalars
+                      , QColor4ub* colors
+                      , std::size_t size ) const;
 };
 
 coloured* colourFromString( const std::string& s, const std::string& fields, const QColor4ub& backgroundcolour );
@@ -0,0 +1,189 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <QFontMetrics>
+#include <QGLShaderProgram>
+#include <QPainter>
+#include <comma/base/exception.h>
+#include "./LabelAtlas.h"
+
+namespace snark { namespace graphics { namespace View {
+
+static const int atlasSize = 1024;
+
+static const char* vertexShader =
+    "attribute highp vec4 qt_Vertex;\n"
+    "attribute lowp vec4 qt_Color;\n"
+    "attribute highp vec4 qt_MultiTexCoord0;\n"
+    "uniform highp mat4 qt_ModelViewProjectionMatrix;\n"
+    "varying lowp vec4 color;\n"
+    "varying highp vec4 texcoord;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = qt_ModelViewProjectionMatrix * qt_Vertex;\n"
+    "    color = qt_Color;\n"
+    "    texcoord = qt_MultiTexCoord0;\n"
+    "}\n";
+
+static const char* fragmentShader =
+    "uniform sampler2D qt_Texture0;\n"
+    "varying lowp vec4 color;\n"
+    "varying highp vec4 texcoord;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4( color.rgb, color.a * texture2D( qt_Texture0, texcoord.st ).a );\n"
+    "}\n";
+
+LabelAtlas::LabelAtlas( std::size_t cacheSize )
+    : m_cacheSize( cacheSize )
+    , m_font( "helvetica", 64 )
+    , m_image( atlasSize, atlasSize, QImage::Format_ARGB32 )
+{
+    clear();
+}
+
+bool LabelAtlas::supported() { return QGLShaderProgram::hasOpenGLShaderPrograms(); }
+
+void LabelAtlas::clear()
+{
+    m_image.fill( Qt::transparent );
+    m_dirty = true;
+    m_x = 0;
+    m_y = 0;
+    m_shelfHeight = 0;
+    m_glyphs.clear();
+    m_lru.clear();
+    m_cache.clear();
+}
+
+const LabelAtlas::Glyph& LabelAtlas::glyph( QChar c )
+{
+    std::map< ushort, Glyph >::const_iterator it = m_glyphs.find( c.unicode() );
+    if( it != m_glyphs.end() ) { return it->second; }
+    QFontMetrics metrics( m_font );
+    Glyph g;
+    g.rect = metrics.boundingRect( c ).adjusted( -1, -1, 1, 1 ); // margin against bleeding of neighbours
+    g.advance = metrics.width( c );
+    if( m_x + g.rect.width() > atlasSize ) { m_x = 0; m_y += m_shelfHeight; m_shelfHeight = 0; }
+    if( m_y + g.rect.height() > atlasSize ) { COMMA_THROW( comma::exception, "glyph atlas full" ); }
+    QPainter painter( &m_image );
+    painter.setRenderHint( QPainter::Antialiasing );
+    painter.setFont( m_font );
+    painter.setPen( Qt::white );
+    painter.drawText( m_x - g.rect.x(), m_y - g.rect.y(), QString( c ) );
+    painter.end();
+    g.texture = QRectF( double( m_x ) / atlasSize, 1 - double( m_y + g.rect.height() ) / atlasSize, double( g.rect.width() ) / atlasSize, double( g.rect.height() ) / atlasSize ); // texture is upside down
+    m_x += g.rect.width();
+    m_shelfHeight = std::max( m_shelfHeight, g.rect.height() );
+    m_dirty = true;
+    return m_glyphs[ c.unicode() ] = g;
+}
+
+const LabelAtlas::Layout& LabelAtlas::layout( const QString& text, const QColor4ub& color )
+{
+    Key key( text, qRgba( color.red(), color.green(), color.blue(), color.alpha() ) );
+    std::map< Key, Lru::iterator >::iterator it = m_cache.find( key );
+    if( it != m_cache.end() )
+    {
+        m_lru.splice( m_lru.begin(), m_lru, it->second );
+        return it->second->second;
+    }
+    if( m_cache.size() >= m_cacheSize )
+    {
+        m_cache.erase( m_lru.back().first );
+        m_lru.pop_back();
+    }
+    m_lru.push_front( std::make_pair( key, Layout() ) );
+    m_cache[ key ] = m_lru.begin();
+    Layout& l = m_lru.front().second;
+    int descent = QFontMetrics( m_font ).descent();
+    int pen = 0;
+    for( int i = 0; i < text.size(); ++i )
+    {
+        const Glyph& g = glyph( text[i] );
+        float left = pen + g.rect.left();
+        float right = pen + g.rect.left() + g.rect.width();
+        float bottom = descent - g.rect.top() - g.rect.height(); // y is up in the scene
+        float top = descent - g.rect.top();
+        QVector3D corners[] = { QVector3D( left, bottom, 0 ), QVector3D( right, bottom, 0 ), QVector3D( right, top, 0 ), QVector3D( left, top, 0 ) };
+        QVector2D texcoords[] = { QVector2D( g.texture.left(), g.texture.top() ), QVector2D( g.texture.right(), g.texture.top() ), QVector2D( g.texture.right(), g.texture.bottom() ), QVector2D( g.texture.left(), g.texture.bottom() ) };
+        static const unsigned int triangles[] = { 0, 1, 2, 0, 2, 3 };
+        for( unsigned int j = 0; j < 6; ++j )
+        {
+            l.vertices.push_back( corners[ triangles[j] ] );
+            l.texcoords.push_back( texcoords[ triangles[j] ] );
+        }
+        pen += g.advance;
+    }
+    return l;
+}
+
+void LabelAtlas::add( QGLPainter* painter, const QString& text, const QColor4ub& color )
+{
+    const Layout* l;
+    try { l = &layout( text, color ); }
+    catch( comma::exception& ) // atlas full: labels added so far refer to the current atlas, draw them before starting over
+    {
+        draw( painter );
+        clear();
+        l = &layout( text, color );
+    }
+    const QMatrix4x4 modelview = painter->modelViewMatrix().top();
+    for( std::size_t i = 0; i < l->vertices.size(); ++i )
+    {
+        m_vertices.append( modelview.map( l->vertices[i] ) );
+        m_texcoords.append( l->texcoords[i] );
+        m_colors.append( color );
+    }
+}
+
+void LabelAtlas::draw( QGLPainter* painter )
+{
+    if( m_vertices.isEmpty() ) { return; }
+    if( !m_effect )
+    {
+        m_effect.reset( new QGLShaderProgramEffect );
+        m_effect->setVertexShader( vertexShader );
+        m_effect->setFragmentShader( fragmentShader );
+    }
+    if( m_dirty )
+    {
+        m_texture.setImage( m_image );
+        m_dirty = false;
+    }
+    painter->modelViewMatrix().push();
+    painter->modelViewMatrix().setToIdentity(); // vertices are in eye coordinates already
+    painter->setUserEffect( m_effect.get() );
+    painter->clearAttributes();
+    painter->setVertexAttribute( QGL::Position, m_vertices );
+    painter->setVertexAttribute( QGL::TextureCoord0, m_texcoords );
+    painter->setVertexAttribute( QGL::Color, m_colors );
+    m_texture.bind();
+    glDepthMask( GL_FALSE );
+    painter->draw( QGL::Triangles, m_vertices.size() );
+    glDepthMask( GL_TRUE );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+    painter->setUserEffect( NULL );
+    painter->modelViewMatrix().pop();
+    m_vertices.resize( 0 ); // keep capacity for the next frame
+    m_texcoords.resize( 0 );
+    m_colors.resize( 0 );
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
@@ -0,0 +1,103 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_LABEL_ATLAS_H_
+#define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_LABEL_ATLAS_H_
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <Qt3D/qarray.h>
+#include <Qt3D/qcolor4ub.h>
+#include <Qt3D/qglpainter.h>
+#include <Qt3D/qglshaderprogrameffect.h>
+#include <Qt3D/qgltexture2d.h>
+#include <Qt3D/qvector2darray.h>
+#include <Qt3D/qvector3darray.h>
+#include <QFont>
+#include <QImage>
+#include <QRectF>
+#include <QString>
+
+namespace snark { namespace graphics { namespace View {
+
+/// text labels drawn from a glyph atlas, shared by all readers
+///
+/// glyphs get rasterised once, white on transparent, into a single texture; a label gets laid out
+/// into glyph quads once and kept in a least recently used cache keyed by its text and colour;
+/// labels added during a frame are collected in eye coordinates and drawn by draw() in a single call,
+/// the glyph coverage tinted with the label colour
+class LabelAtlas
+{
+    public:
+        /// @param cacheSize maximum number of laid out labels to keep
+        LabelAtlas( std::size_t cacheSize = 4096 );
+
+        /// return true, if the atlas can be used in the current gl context, i.e. shader programs are supported
+        static bool supported();
+
+        /// add label in the current model view coordinates, in pixels of the glyph font, lower left corner at the origin
+        /// if the glyph atlas is full, labels added so far get drawn before the atlas is cleared
+        void add( QGLPainter* painter, const QString& text, const QColor4ub& color );
+
+        /// draw all labels added since the last call
+        void draw( QGLPainter* painter );
+
+    private:
+        struct Glyph
+        {
+            QRectF texture; // texture coordinates
+            QRect rect; // relative to pen position on the baseline, y pointing down
+            int advance;
+        };
+
+        struct Layout
+        {
+            std::vector< QVector3D > vertices; // 6 per glyph
+            std::vector< QVector2D > texcoords;
+        };
+
+        typedef std::pair< QString, QRgb > Key;
+        typedef std::list< std::pair< Key, Layout > > Lru;
+
+        const Glyph& glyph( QChar c );
+        const Layout& layout( const QString& text, const QColor4ub& color );
+        void clear();
+
+        const std::size_t m_cacheSize;
+        QFont m_font;
+        QImage m_image;
+        bool m_dirty; // image changed since last upload
+        QGLTexture2D m_texture;
+        int m_x; // shelf packing: next free position
+        int m_y;
+        int m_shelfHeight;
+        std::map< ushort, Glyph > m_glyphs;
+        Lru m_lru; // most recently used first
+        std::map< Key, Lru::iterator > m_cache;
+        QVector3DArray m_vertices; // current frame
+        QVector2DArray m_texcoords;
+        QArray< QColor4ub > m_colors;
+        boost::scoped_ptr< QGLShaderProgramEffect > m_effect;
+};
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif /*SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_LABEL_ATLAS_H_*/
@@ -72,6 +72,12 @@ MainWindow::MainWindow( const std::string& title, Viewer* viewer )
     ToggleAction* action = new ToggleAction( "File Panel", boost::bind( &MainWindow::toggleFileFrame, this, _1 ) );
     action->setChecked( m_fileFrameVisible );
     m_viewMenu->addAction( action );
+    QMenu* colourMenu = menuBar()->addMenu( "Colour" );
+    colourMenu->addAction( new Action( "Original", boost::bind( &MainWindow::recolor, this, std::string( "original" ) ) ) );
+    colourMenu->addAction( new Action( "By Height...", boost::bind( &MainWindow::recolor, this, std::string( "height" ) ) ) );
+    colourMenu->addAction( new Action( "By Scalar...", boost::bind( &MainWindow::recolor, this, std::string( "scalar" ) ) ) );
+    colourMenu->addAction( new Action( "By Id", boost::bind( &MainWindow::recolor, this, std::string( "id" ) ) ) );
+    colourMenu->addAction( new Action( "Fixed...", boost::bind( &MainWindow::recolor, this, std::string( "fixed" ) ) ) );
     updateFileFrame();
     toggleFileFrame( m_fileFrameVisible );
     setWindowTitle( title.c_str() );
@@ -149,6 +155,28 @@ void MainWindow::updateFileFrame() // quick and dirty
     }
 }
 
+void MainWindow::recolor( const std::string& mode ) // quick and dirty: make colour map from fields, as if they were given on the command line
+{
+    std::string fields = "x,y,z";
+    std::string colour;
+    if( mode == "original" ) { fields = "x,y,z,r,g,b"; } // colours points have been read with
+    else if( mode == "id" ) { fields = "x,y,z,id"; }
+    else
+    {
+        if( mode == "scalar" ) { fields = "x,y,z,scalar"; }
+        std::string& last = m_colourMaps[ mode ];
+        if( last.empty() ) { last = mode == "height" ? "-10:10" : mode == "scalar" ? "0:1" : "white"; }
+        const char* prompt = mode == "height" ? "colour map, e.g. -10:10,red:yellow,sharp" : mode == "scalar" ? "colour map, e.g. 0:1,magenta:cyan" : "colour, e.g. white";
+        bool ok = false;
+        QString text = QInputDialog::getText( this, "Colour", prompt, QLineEdit::Normal, last.c_str(), &ok );
+        if( !ok ) { return; }
+        colour = last = text.toStdString();
+    }
+    try { m_viewer.recolor( colour, fields ); }
+    catch( std::exception& ex ) { std::cerr << "view-points: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "view-points: unknown exception" << std::endl; }
+}
+
 void MainWindow::toggleFileFrame( bool visible )
 {
     m_fileFrameVisible = visible;
@@ -55,6 +55,7 @@ class MainWindow : public QMainWindow
         bool m_fileFrameVisible;
         typedef std::map< std::string, std::vector< CheckBox* > > FileGroupMap;
         FileGroupMap m_fileGroups; // quick and dirty
+        std::map< std::string, std::string > m_colourMaps; // last colour map entered by colour mode
     
         void closeEvent( QCloseEvent* event );
         void keyPressEvent( QKeyEvent *e );
@@ -62,6 +63,7 @@ class MainWindow : public QMainWindow
         void toggleFileFrame( bool shown );
         void makeFileGroups();
         void showFileGroup( std::string name, bool shown );
+        void recolor( const std::string& mode );
 };
 
 class CheckBox : public QCheckBox // quick and dirty
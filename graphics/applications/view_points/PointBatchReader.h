@@ -0,0 +1,318 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_POINT_BATCH_READER_H_
+#define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_POINT_BATCH_READER_H_
+
+#include <algorithm>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <comma/base/types.h>
+#include <snark/graphics/ring_buffer.h>
+#include <snark/graphics/qt3d/point_octree.h>
+#include "./ColourSources.h"
+#include "./Reader.h"
+#include "./ShapeWithId.h"
+
+namespace snark { namespace graphics { namespace View {
+
+/// base for point readers that decode, colour and pack points into vertices in batches on the reader thread
+/// and hand whole batches over to the viewer, which only adds the vertices to its vertex buffer
+/// once the input is over and there are more points than the point budget, builds a level-of-detail
+/// octree in background and from then on draws only as many points per frame as the budget allows
+/// keeps what points have been coloured from to colour them again, if the colour map changes at runtime
+template< typename V = qt3d::packed_vertex >
+class PointBatchReader : public Reader
+{
+    public:
+        PointBatchReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize, bool verbose, std::size_t queueSize, ring_buffer_policy::values dropPolicy, std::size_t pointBudget, float resolution );
+
+        void start();
+        void update( const Eigen::Vector3d& offset );
+        const Eigen::Vector3d& somePoint() const;
+        void render( QGLPainter *painter = NULL );
+        bool empty() const;
+        void shutdown();
+        void recolor( coloured* c, const Eigen::Vector3d& offset );
+
+    protected:
+        struct Batch
+        {
+            std::vector< qt3d::packed_vertex > vertices; // coloured, relative to reference
+            std::vector< QColor4ub > colors; // input colours, i.e. before the colour map, for colouring again
+            Eigen::Vector3d reference; // first point of the batch, thus float vertices lose no precision on large coordinates
+            snark::graphics::extents< Eigen::Vector3f > extents; // of vertices
+            std::vector< comma::uint32 > ids; // empty, if absent
+            std::vector< double > scalars; // empty, if absent
+
+            /// colour all the points at once, colors holding their input colours, and pack them into vertices; ids and scalars, if any, have to be set
+            void pack( const std::vector< Eigen::Vector3d >& points, std::vector< QColor4ub >& colors, const coloured& c );
+
+            void swap( Batch& rhs );
+        };
+
+        /// hand over non-empty batch obtained from m_ring.reserve()
+        void publish( const Batch& batch );
+
+        /// output statistics, every 10 seconds if verbose, or at the end of input
+        void report( bool final );
+
+        /// call at the end of input
+        void finish();
+
+        const std::size_t m_batchSize;
+        const bool m_verbose;
+        ring_buffer< Batch > m_ring;
+        comma::uint64 m_count;
+
+    private:
+        void buildOctree();
+        boost::posix_time::ptime m_start;
+        boost::posix_time::ptime m_lastReport;
+        qt3d::basic_vertex_buffer< V > m_buffer;
+        const std::size_t m_pointBudget;
+        boost::atomic< bool > m_finished;
+        QArray< V > m_octreeVertices; // reordered vertices, until handed over to m_buffer
+        std::vector< unsigned int > m_octreePermutation; // original indices of reordered vertices, relative to m_octreeFirst
+        unsigned int m_octreeFirst;
+        ColourSources m_sources;
+        std::vector< Eigen::Vector3d > m_recoloredPoints;
+        std::vector< QColor4ub > m_recoloredBatch;
+        Eigen::Vector3d m_recoloredOffset;
+        boost::scoped_ptr< qt3d::basic_point_octree< V > > m_octree;
+        boost::scoped_ptr< boost::thread > m_octreeThread;
+        boost::atomic< bool > m_octreeReady;
+        boost::atomic< bool > m_octreeCancel;
+};
+
+template< typename V >
+PointBatchReader< V >::PointBatchReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize, bool verbose, std::size_t queueSize, ring_buffer_policy::values dropPolicy, std::size_t pointBudget, float resolution ):
+    Reader( viewer, options, size, c, pointSize, label ),
+    m_batchSize( batchSize == 0 ? 1 : batchSize ),
+    m_verbose( verbose ),
+    m_ring( std::max( std::size_t( 2 ), ( queueSize == 0 ? 262144 : queueSize ) / m_batchSize ), dropPolicy ), // by default, a few megabytes of vertices
+    m_count( 0 ),
+    m_buffer( size, false, resolution ),
+    m_pointBudget( pointBudget ),
+    m_finished( false ),
+    m_octreeFirst( 0 ),
+    m_sources( options.fields ),
+    m_octreeReady( false ),
+    m_octreeCancel( false )
+{
+}
+
+template< typename V >
+inline void PointBatchReader< V >::Batch::pack( const std::vector< Eigen::Vector3d >& points, std::vector< QColor4ub >& colors, const coloured& c )
+{
+    this->colors = colors;
+    c.color_batch( &points[0], ids.empty() ? NULL : &ids[0], scalars.empty() ? NULL : &scalars[0], &colors[0], points.size() );
+    reference = points[0];
+    vertices.resize( points.size() ); // batches are reused, hence no reallocation after the first few batches
+    extents = snark::graphics::extents< Eigen::Vector3f >();
+    for( std::size_t i = 0; i < points.size(); ++i )
+    {
+        Eigen::Vector3f p = ( points[i] - reference ).cast< float >();
+        vertices[i].x = p.x();
+        vertices[i].y = p.y();
+        vertices[i].z = p.z();
+        vertices[i].color = colors[i];
+        extents.add( p );
+    }
+}
+
+template< typename V >
+inline void PointBatchReader< V >::Batch::swap( Batch& rhs )
+{
+    vertices.swap( rhs.vertices );
+    colors.swap( rhs.colors );
+    std::swap( reference, rhs.reference );
+    std::swap( extents, rhs.extents );
+    ids.swap( rhs.ids );
+    scalars.swap( rhs.scalars );
+}
+
+template< typename V >
+inline void PointBatchReader< V >::start()
+{
+    m_extents = snark::graphics::extents< Eigen::Vector3f >();
+    m_start = m_lastReport = boost::posix_time::microsec_clock::universal_time();
+    m_thread.reset( new boost::thread( boost::bind( &Reader::read, boost::ref( *this ) ) ) );
+}
+
+template< typename V >
+inline void PointBatchReader< V >::update( const Eigen::Vector3d& offset )
+{
+    bool finished = m_finished; // everything published before it has been set gets claimed below
+    unsigned int widened = m_buffer.widened();
+    std::size_t size = m_ring.claim();
+    for( std::size_t i = 0; i < size; ++i )
+    {
+        const Batch& batch = m_ring.claimed( i );
+        const std::size_t n = batch.vertices.size();
+        const Eigen::Vector3d d = batch.reference - offset;
+        const Eigen::Vector3f s = d.cast< float >();
+        QVector3D shift( s.x(), s.y(), s.z() );
+        if( m_recolored ) // colour map has been changed at runtime; quick and dirty: rebuild points from vertices
+        {
+            m_recoloredPoints.resize( n );
+            m_recoloredBatch.resize( n );
+            for( std::size_t j = 0; j < n; ++j )
+            {
+                const qt3d::packed_vertex& v = batch.vertices[j];
+                m_recoloredPoints[j] = batch.reference + Eigen::Vector3d( v.x, v.y, v.z );
+                m_recoloredBatch[j] = batch.colors[j];
+            }
+            m_recolored->color_batch( &m_recoloredPoints[0], batch.ids.empty() ? NULL : &batch.ids[0], batch.scalars.empty() ? NULL : &batch.scalars[0], &m_recoloredBatch[0], n );
+        }
+        for( std::size_t j = 0; j < n; ++j )
+        {
+            const qt3d::packed_vertex& v = batch.vertices[j];
+            m_buffer.addVertex( QVector3D( v.x, v.y, v.z ) + shift, m_recolored ? m_recoloredBatch[j] : v.color );
+            m_sources.set( m_buffer.last(), batch.ids.empty() ? 0 : batch.ids[j], batch.scalars.empty() ? 0 : batch.scalars[j], batch.colors[j] );
+        }
+        if( m_extents ) { m_extents->add( batch.extents.min() + s ); m_extents->add( batch.extents.max() + s ); }
+    }
+    m_ring.release();
+    if( widened == 0 && m_buffer.widened() > 0 ) { std::cerr << "view-points: warning: " << options.filename << ": points farther than 32767 steps of resolution from the first point of their chunk; falling back to float vertices for such chunks" << std::endl; }
+    updatePoint( offset );
+    if( finished && m_pointBudget > 0 && !m_octreeThread && m_buffer.size() > m_pointBudget && m_buffer.rebase() ) // quick and dirty: no level of detail, if points do not fit around a single origin
+    {
+        m_octreeFirst = m_buffer.index();
+        m_octreeVertices = m_buffer.vertices().mid( m_buffer.index(), m_buffer.size() );
+        m_octreeThread.reset( new boost::thread( boost::bind( &PointBatchReader< V >::buildOctree, boost::ref( *this ) ) ) );
+    }
+}
+
+template< typename V >
+inline void PointBatchReader< V >::buildOctree()
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    m_octree.reset( new qt3d::basic_point_octree< V >( m_octreeVertices, 16384, &m_octreePermutation, &m_octreeCancel ) );
+    if( m_octree->cancelled() ) { return; }
+    if( m_verbose ) { std::cerr << "view-points: " << options.filename << ": built level-of-detail octree of " << m_octree->size() << " node(s) over " << m_octreeVertices.size() << " point(s) in " << ( boost::posix_time::microsec_clock::universal_time() - start ).total_milliseconds() / 1000. << " s" << std::endl; }
+    m_octreeReady = true;
+}
+
+template< typename V >
+inline bool PointBatchReader< V >::empty() const
+{
+    if( m_ring.empty() ) { return true; }
+    boost::mutex::scoped_lock lock( m_mutex );
+    return !m_point;
+}
+
+template< typename V >
+inline const Eigen::Vector3d& PointBatchReader< V >::somePoint() const
+{
+    boost::mutex::scoped_lock lock( m_mutex );
+    return *m_point;
+}
+
+template< typename V >
+inline void PointBatchReader< V >::shutdown()
+{
+    m_ring.close();
+    Reader::shutdown();
+    m_octreeCancel = true;
+    if( m_octreeThread ) { m_octreeThread->join(); }
+}
+
+template< typename V >
+inline void PointBatchReader< V >::recolor( coloured* c, const Eigen::Vector3d& offset )
+{
+    Reader::recolor( c, offset );
+    m_recoloredOffset = offset;
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    m_sources.recolor( *c, m_buffer, offset );
+    if( m_verbose ) { std::cerr << "view-points: " << options.filename << ": recoloured " << m_buffer.size() << " point(s) in " << ( boost::posix_time::microsec_clock::universal_time() - start ).total_milliseconds() << " ms" << std::endl; }
+}
+
+template< typename V >
+inline void PointBatchReader< V >::render( QGLPainter* painter )
+{
+    painter->setStandardEffect(QGL::FlatPerVertexColor);
+    painter->clearAttributes();
+    if( m_octreeReady && !m_octreeVertices.isEmpty() ) // octree has just been built
+    {
+        m_buffer.assign( m_octreeVertices );
+        m_octreeVertices = QArray< V >();
+        m_sources.reorder( m_octreePermutation, m_octreeFirst );
+        std::vector< unsigned int >().swap( m_octreePermutation );
+        if( m_recolored ) { m_sources.recolor( *m_recolored, m_buffer, m_recoloredOffset ); } // colour map may have changed while building
+    }
+    m_buffer.bind( painter );
+    if( m_octreeReady ) { m_octree->draw( painter, m_pointBudget, pointSize ); }
+    else
+    {
+        std::vector< typename qt3d::basic_vertex_buffer< V >::interval > visible = m_buffer.visible( painter );
+        for( std::size_t i = 0; i < visible.size(); ++i )
+        {
+            m_buffer.select( painter, visible[i] );
+            Shapetraits< Eigen::Vector3d >::draw( painter, visible[i].second - visible[i].first, visible[i].first );
+        }
+    }
+    m_buffer.release( painter );
+    if( !m_label.empty() )
+    {
+        drawLabel( painter, m_translation );
+    }
+}
+
+template< typename V >
+inline void PointBatchReader< V >::publish( const Batch& batch )
+{
+    {
+        boost::mutex::scoped_lock lock( m_mutex );
+        const qt3d::packed_vertex& v = batch.vertices.back();
+        m_point = batch.reference + Eigen::Vector3d( v.x, v.y, v.z );
+        m_color = v.color;
+    }
+    m_ring.push();
+    m_ring.publish();
+    report( false );
+}
+
+template< typename V >
+inline void PointBatchReader< V >::finish()
+{
+    report( true );
+    m_finished = true;
+    m_shutdown = true;
+}
+
+template< typename V >
+inline void PointBatchReader< V >::report( bool final )
+{
+    if( !m_verbose ) { return; }
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if( final )
+    {
+        std::cerr << "view-points: " << options.filename << ": read " << m_count << " record(s) in " << ( now - m_start ).total_milliseconds() / 1000. << " s; dropped " << m_ring.dropped() << " batch(es)" << std::endl;
+        return;
+    }
+    if( now - m_lastReport < boost::posix_time::seconds( 10 ) ) { return; }
+    m_lastReport = now;
+    std::cerr << "view-points: " << options.filename << ": read " << m_count << " record(s) at " << std::size_t( double( m_count ) / ( now - m_start ).total_milliseconds() * 1000 ) << " records/s; dropped " << m_ring.dropped() << " batch(es)" << std::endl;
+}
+
+} } } // namespace snark { namespace graphics { namespace View {
+
+#endif // SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_POINT_BATCH_READER_H_
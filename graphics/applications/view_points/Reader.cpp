@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <signal.h>
 #endif
+#include <algorithm>
 #include <deque>
 #include <fstream>
 #include <iostream>
@@ -33,6 +34,7 @@
 #include <comma/csv/stream.h>
 #include <comma/io/select.h>
 #include <snark/graphics/qt3d/rotation_matrix.h>
+#include "./LabelAtlas.h"
 #include "./Reader.h"
 #include "./Texture.h"
 
@@ -43,6 +45,7 @@ Reader::Reader( QGLView& viewer, comma::csv::options& options, std::size_t size,
     , pointSize( pointSize )
     , options( options )
     , m_viewer( viewer )
+    , m_labelAtlas( NULL )
     , m_colored( c )
     , m_shutdown( false )
     , m_show( true )
@@ -62,10 +65,18 @@ void Reader::shutdown()
 
 bool Reader::isShutdown() const { return m_shutdown; }
 
+bool Reader::hasField( const std::string& fields, const std::string& name )
+{
+    std::vector< std::string > v = comma::split( fields, ',' );
+    return std::find( v.begin(), v.end(), name ) != v.end();
+}
+
 void Reader::show( bool s ) { m_show = s; }
 
 bool Reader::show() const { return m_show; }
 
+void Reader::recolor( coloured* c, const Eigen::Vector3d& ) { m_recolored.reset( c ); }
+
 void Reader::read()
 {
     while( !m_shutdown && readOnce() );
@@ -89,6 +100,7 @@ void Reader::updatePoint( const Eigen::Vector3d& offset )
 
 void Reader::drawLabel( QGLPainter *painter, const QVector3D& position, const std::string& label )
 {
+    if( painter->isCullable( position ) ) { return; }
     painter->modelViewMatrix().push();
     painter->modelViewMatrix().translate( position );
 
@@ -125,6 +137,7 @@ void Reader::drawLabel( QGLPainter *painter, const QVector3D& position )
 
 void Reader::drawText( QGLPainter *painter, const QString& string, const QColor4ub& color )
 {
+    if( m_labelAtlas ) { m_labelAtlas->add( painter, string, color ); return; }
     Texture texture( string, color );
     texture.draw( painter );
 }
@@ -43,6 +43,7 @@ class QGLAbstractScene;
 
 namespace snark { namespace graphics { namespace View {
 
+class LabelAtlas;
 class Viewer;
 
 class Reader
@@ -66,18 +67,26 @@ class Reader
         void show( bool s );
         bool show() const;
         bool isShutdown() const;
-        void shutdown();
+        virtual void shutdown();
         void read();
 
+        /// colour what has been read and what will be read with the given colour map from now on, taking ownership;
+        /// by default, only applies to what will be read; call in gui thread
+        /// @param offset as passed to update()
+        virtual void recolor( coloured* c, const Eigen::Vector3d& offset );
+
     protected:
         void updatePoint( const Eigen::Vector3d& offset );
+        static bool hasField( const std::string& fields, const std::string& name );
         void drawLabel( QGLPainter* painter, const QVector3D& position, const std::string& label );
         void drawLabel( QGLPainter* painter, const QVector3D& position );
         
         friend class Viewer;
         QGLView& m_viewer;
+        LabelAtlas* m_labelAtlas; // set by viewer; if none, labels get drawn one by one
         boost::optional< snark::graphics::extents< Eigen::Vector3f > > m_extents;
         boost::scoped_ptr< coloured > m_colored;
+        boost::scoped_ptr< coloured > m_recolored; // colour map set at runtime, if any; used in gui thread only
         bool m_shutdown;
         bool m_show;
         comma::io::istream m_istream;
@@ -25,16 +25,20 @@
 //#include <windows.h>
 #endif
 
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <snark/graphics/ring_buffer.h>
+#include "./ColourSources.h"
 #include "./Reader.h"
 #include "./ShapeWithId.h"
 
 namespace snark { namespace graphics { namespace View {
 
-template< typename S >    
+template< typename S, typename V = qt3d::packed_vertex >
 class ShapeReader : public Reader
 {
     public:
-        ShapeReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label );
+        ShapeReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize = 4096, bool verbose = false, std::size_t queueSize = 0, ring_buffer_policy::values dropPolicy = ring_buffer_policy::drop_oldest, float resolution = 0.001 );
 
         void start();
         void update( const Eigen::Vector3d& offset );
@@ -42,71 +46,144 @@ class ShapeReader : public Reader
         bool readOnce();
         void render( QGLPainter *painter = NULL );
         bool empty() const;
+        void shutdown();
+        void recolor( coloured* c, const Eigen::Vector3d& offset );
 
-    private:        
-        typedef std::deque< ShapeWithId< S > > DequeType;
-        DequeType m_deque;
-        mutable boost::mutex m_mutex;
+    private:
+        void publish();
+        void renderVertices( QGLPainter* painter );
+        const std::size_t m_batchSize;
+        const bool m_verbose;
+        struct Record // as read and coloured by the colour map given on the command line
+        {
+            ShapeWithId< S > shape; // with its input colour, for colouring again
+            QColor4ub color;
+        };
+        ring_buffer< Record > m_ring; // records are written in place by the reader thread and read in place by update()
+        std::size_t m_pushed; // pushed, but not published yet
+        Eigen::Vector3d m_lastPoint; // last pushed, to be handed over on publish
+        QColor4ub m_lastColor;
+        comma::uint64 m_count;
+        boost::posix_time::ptime m_start;
+        boost::posix_time::ptime m_lastReport;
         boost::scoped_ptr< comma::csv::input_stream< ShapeWithId< S > > > m_stream;
-        qt3d::vertex_buffer m_buffer;
+        const float m_resolution;
+        boost::scoped_ptr< qt3d::basic_vertex_buffer< V > > m_buffer; // allocated in start(), unless shapes get drawn instanced
+        boost::scoped_ptr< qt3d::instance_buffer > m_instances; // allocated in start() instead of m_buffer, if shapes get drawn instanced
+        boost::scoped_ptr< qt3d::instanced_shapes > m_instanced;
+        ColourSources m_sources;
+        QGLIndexBuffer m_indices; // line indices of all the shapes the buffer can hold, if shapes are indexed
+        unsigned int m_indexed; // number of vertices m_indices covers
         std::vector< std::pair< QVector3D, std::string > > m_labels;
         unsigned int m_labelIndex;
         unsigned int m_labelSize;
 };
 
 
-template< typename S >    
-ShapeReader< S >::ShapeReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label  ):
+template< typename S, typename V >
+ShapeReader< S, V >::ShapeReader( QGLView& viewer, comma::csv::options& options, std::size_t size, coloured* c, unsigned int pointSize, const std::string& label, std::size_t batchSize, bool verbose, std::size_t queueSize, ring_buffer_policy::values dropPolicy, float resolution ):
     Reader( viewer, options, size, c, pointSize, label ),
-    m_buffer( size * Shapetraits< S >::size ),
+    m_batchSize( batchSize == 0 ? 1 : batchSize ),
+    m_verbose( verbose ),
+    m_ring( queueSize == 0 ? 10000 : queueSize, dropPolicy ), // by default, about a megabyte of records
+    m_pushed( 0 ),
+    m_count( 0 ),
+    m_resolution( resolution ),
+    m_sources( options.fields, Shapetraits< S >::size ),
+    m_indexed( 0 ),
     m_labels( size ),
     m_labelIndex( 0 ),
     m_labelSize( 0 )
 {
 }
 
-template< typename S >
-inline void ShapeReader< S >::start()
+template< typename S, typename V >
+inline void ShapeReader< S, V >::start()
 {
     m_extents = snark::graphics::extents< Eigen::Vector3f >();
+    if( Shapetraits< S >::instanced && qt3d::instanced_shapes::supported() ) // called in gl context
+    {
+        m_instanced.reset( new qt3d::instanced_shapes( Shapetraits< S >::outline() ) );
+        m_instances.reset( new qt3d::instance_buffer( size, hasField( options.fields, "block" ) ) );
+        m_sources = ColourSources( options.fields, 1 ); // one instance per shape
+    }
+    else
+    {
+        m_buffer.reset( new qt3d::basic_vertex_buffer< V >( size * Shapetraits< S >::size, hasField( options.fields, "block" ), m_resolution ) );
+    }
+    m_start = m_lastReport = boost::posix_time::microsec_clock::universal_time();
     m_thread.reset( new boost::thread( boost::bind( &Reader::read, boost::ref( *this ) ) ) );
 }
 
-template< typename S >
-inline void ShapeReader< S >::update( const Eigen::Vector3d& offset )
+template< typename S, typename V >
+inline void ShapeReader< S, V >::update( const Eigen::Vector3d& offset )
 {
-    boost::mutex::scoped_lock lock( m_mutex );
-    for( typename DequeType::iterator it = m_deque.begin(); it != m_deque.end(); ++it )
+    unsigned int widened = m_buffer ? m_buffer->widened() : 0;
+    std::size_t size = m_ring.claim(); // take all published records at once
+    for( std::size_t i = 0; i < size; ++i )
     {
-        Shapetraits< S >::update( it->shape, offset, it->color, it->block, m_buffer, m_extents );
+        const Record& r = m_ring.claimed( i );
+        const ShapeWithId< S >& v = r.shape;
+        QColor4ub color = m_recolored ? m_recolored->color( Shapetraits< S >::centre( v.shape ), v.id, v.scalar, v.color ) : r.color; // colour map may have been changed at runtime
+        if( m_instanced )
+        {
+            Shapetraits< S >::instance( v.shape, offset, color, v.block, *m_instances, m_extents );
+            m_sources.set( m_instances->last(), v.id, v.scalar, v.color );
+        }
+        else
+        {
+            Shapetraits< S >::update( v.shape, offset, color, v.block, *m_buffer, m_extents );
+            m_sources.set( m_buffer->last() + 1 - Shapetraits< S >::size, v.id, v.scalar, v.color );
+        }
     }
-    m_deque.clear();
+    m_ring.release();
+    if( widened == 0 && m_buffer && m_buffer->widened() > 0 ) { std::cerr << "view-points: warning: " << options.filename << ": points farther than 32767 steps of resolution from the first point of their chunk; falling back to float vertices for such chunks" << std::endl; }
     updatePoint( offset );
 }
 
-template< typename S >
-inline bool ShapeReader< S >::empty() const
+template< typename S, typename V >
+inline bool ShapeReader< S, V >::empty() const
 {
+    if( m_ring.empty() ) { return true; }
     boost::mutex::scoped_lock lock( m_mutex );
-    return m_deque.empty();
+    return !m_point; // a full ring may publish records before publish() sets m_point
 }
 
-template< typename S >
-inline const Eigen::Vector3d& ShapeReader< S >::somePoint() const
+template< typename S, typename V >
+inline const Eigen::Vector3d& ShapeReader< S, V >::somePoint() const
 {
     boost::mutex::scoped_lock lock( m_mutex );
-    return Shapetraits< S >::somePoint( m_deque.front().shape );
+    return *m_point; // set before the first record is published
 }
 
-template< typename S >
-inline void ShapeReader< S >::render( QGLPainter* painter )
+template< typename S, typename V >
+inline void ShapeReader< S, V >::shutdown()
 {
-    painter->setStandardEffect(QGL::FlatPerVertexColor);
-    painter->clearAttributes();
-    painter->setVertexAttribute(QGL::Position, m_buffer.points() );
-    painter->setVertexAttribute(QGL::Color, m_buffer.color() );
+    m_ring.close(); // otherwise the reader thread may be blocked on a full ring forever
+    Reader::shutdown();
+}
+
+template< typename S, typename V >
+inline void ShapeReader< S, V >::recolor( coloured* c, const Eigen::Vector3d& offset )
+{
+    Reader::recolor( c, offset );
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    if( m_instanced ) { m_sources.recolor( *c, *m_instances, offset ); }
+    else { m_sources.recolor( *c, *m_buffer, offset ); }
+    if( m_verbose ) { std::cerr << "view-points: " << options.filename << ": recoloured " << ( m_instanced ? m_instances->size() : m_buffer->size() / Shapetraits< S >::size ) << " shape(s) in " << ( boost::posix_time::microsec_clock::universal_time() - start ).total_milliseconds() << " ms" << std::endl; }
+}
 
-    Shapetraits< S >::draw( painter, m_buffer.size(), m_buffer.index() );
+template< typename S, typename V >
+inline void ShapeReader< S, V >::render( QGLPainter* painter )
+{
+    if( m_instanced )
+    {
+        m_instanced->draw( painter, *m_instances ); // one call for all the shapes; the gpu clips them
+    }
+    else
+    {
+        renderVertices( painter );
+    }
     for( unsigned int i = 0; i < m_labelSize; i++ )
     {
         drawLabel( painter, m_labels[ i ].first, m_labels[ i ].second );
@@ -117,8 +194,49 @@ inline void ShapeReader< S >::render( QGLPainter* painter )
     }
 }
 
-template< typename S >
-inline bool ShapeReader< S >::readOnce()
+template< typename S, typename V >
+inline void ShapeReader< S, V >::renderVertices( QGLPainter* painter )
+{
+    painter->setStandardEffect(QGL::FlatPerVertexColor);
+    painter->clearAttributes();
+    m_buffer->bind( painter );
+    if( Shapetraits< S >::indices > 0 && m_indexed != m_buffer->allocated() ) // once, or once more, if the second half for blocks has been allocated
+    {
+        m_indexed = m_buffer->allocated();
+        QArray< uint > indices;
+        indices.reserve( m_indexed / Shapetraits< S >::size * Shapetraits< S >::indices );
+        for( unsigned int i = 0; i + Shapetraits< S >::size <= m_indexed; i += Shapetraits< S >::size ) { Shapetraits< S >::index( indices, i ); }
+        m_indices.setIndexes( indices );
+    }
+    std::vector< typename qt3d::basic_vertex_buffer< V >::interval > visible = m_buffer->visible( painter, Shapetraits< S >::size );
+    for( std::size_t i = 0; i < visible.size(); ++i ) // one call for all the visible shapes, unless quantised
+    {
+        m_buffer->select( painter, visible[i] );
+        Shapetraits< S >::draw( painter, visible[i].second - visible[i].first, visible[i].first, &m_indices );
+    }
+    m_buffer->release( painter );
+}
+
+template< typename S, typename V >
+inline void ShapeReader< S, V >::publish()
+{
+    if( m_pushed == 0 ) { return; }
+    {
+        boost::mutex::scoped_lock lock( m_mutex );
+        m_point = m_lastPoint;
+        m_color = m_lastColor;
+    }
+    m_pushed = 0;
+    m_ring.publish(); // one hand-over per batch
+    if( !m_verbose ) { return; }
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if( now - m_lastReport < boost::posix_time::seconds( 10 ) ) { return; }
+    m_lastReport = now;
+    std::cerr << "view-points: " << options.filename << ": read " << m_count << " record(s) at " << std::size_t( double( m_count ) / ( now - m_start ).total_milliseconds() * 1000 ) << " records/s; dropped " << m_ring.dropped() << " record(s)" << std::endl;
+}
+
+template< typename S, typename V >
+inline bool ShapeReader< S, V >::readOnce()
 {
     try
     {
@@ -134,32 +252,49 @@ inline bool ShapeReader< S >::readOnce()
             }
             m_stream.reset( new comma::csv::input_stream< ShapeWithId< S > >( *m_istream(), options ) );
         }
-        const ShapeWithId< S >* p = m_stream->read();
-        if( p == NULL )
+        while( m_pushed < m_batchSize )
         {
-            m_shutdown = true;
-            return false;            
-        }
-        ShapeWithId< S > v = *p;
-        Eigen::Vector3d centre = Shapetraits< S >::centre( v.shape );
-        if( !v.label.empty() )
-        {
-            m_labels[ m_labelIndex ] = std::make_pair( QVector3D( centre.x(), centre.y(), centre.z() ) , v.label );
-            m_labelIndex++;
-            if( m_labelSize < m_labels.size() )
+            const ShapeWithId< S >* p = m_stream->read();
+            if( p == NULL )
             {
-                m_labelSize++;
+                publish();
+                if( m_verbose )
+                {
+                    boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - m_start;
+                    std::cerr << "view-points: " << options.filename << ": read " << m_count << " record(s) in " << elapsed.total_milliseconds() / 1000. << " s; dropped " << m_ring.dropped() << " record(s)" << std::endl;
+                }
+                m_shutdown = true;
+                return false;
             }
-            if( m_labelIndex > m_labels.size() )
+            ++m_count;
+            Record* slot = m_ring.reserve();
+            if( slot != NULL )
             {
-                m_labelIndex = 0;
+                slot->shape = *p; // assignment into the preallocated slot reuses its storage
+                slot->color = m_colored->color( Shapetraits< S >::centre( p->shape ), p->id, p->scalar, p->color );
+                m_lastPoint = Shapetraits< S >::somePoint( p->shape );
+                m_lastColor = slot->color;
+                m_ring.push();
+                ++m_pushed;
             }
+            else if( m_shutdown ) { return false; }
+            if( !p->label.empty() )
+            {
+                Eigen::Vector3d centre = Shapetraits< S >::centre( p->shape );
+                m_labels[ m_labelIndex ] = std::make_pair( QVector3D( centre.x(), centre.y(), centre.z() ) , p->label );
+                m_labelIndex++;
+                if( m_labelSize < m_labels.size() )
+                {
+                    m_labelSize++;
+                }
+                if( m_labelIndex >= m_labels.size() )
+                {
+                    m_labelIndex = 0;
+                }
+            }
+            if( !m_stream->ready() ) { break; } // do not sit on a partial batch while waiting for more input
         }
-        v.color = m_colored->color( centre, p->id, p->scalar, p->color );
-        boost::mutex::scoped_lock lock( m_mutex );
-        m_deque.push_back( v );
-        m_point = Shapetraits< S >::somePoint( v.shape );
-        m_color = v.color;
+        publish();
         return true;
     }
     catch( std::exception& ex ) { std::cerr << "view-points: " << ex.what() << std::endl; }
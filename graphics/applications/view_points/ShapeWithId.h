@@ -19,13 +19,17 @@
 #ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_SHAPEWITHID_H_
 #define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_SHAPEWITHID_H_
 
-#include <boost/foreach.hpp>
 #include <boost/optional.hpp>
 #include <comma/base/types.h>
 #include <comma/visiting/traits.h>
+#include <algorithm>
+#include <cmath>
 #include <snark/graphics/impl/extents.h>
+#include <snark/graphics/qt3d/instanced_shapes.h>
 #include <snark/graphics/qt3d/rotation_matrix.h>
 #include <snark/graphics/qt3d/vertex_buffer.h>
+#include <Qt3D/qarray.h>
+#include <Qt3D/qglindexbuffer.h>
 #include <Qt3D/qglnamespace.h>
 #include <Qt3D/qglpainter.h>
 
@@ -45,6 +49,10 @@ struct ShapeWithId // quick and dirty
 };
 
 
+/// shape traits: size is number of vertices per shape, indices is number of line indices per shape
+/// or 0, if the vertices get drawn as they are; for indexed shapes, index() appends indices of a shape
+/// and draw() expects the indices of all the shapes in the vertex buffer
+/// if instanced, a shape can be drawn instead as one instance() of the outline() shared by all the shapes
 template < class S >
 struct Shapetraits {}; // quick and dirty
 
@@ -53,8 +61,11 @@ struct Shapetraits< Eigen::Vector3d >
 {
     static const QGL::DrawingMode drawingMode = QGL::Points;
     static const unsigned int size = 1;
+    static const unsigned int indices = 0;
+    static const bool instanced = false;
     
-    static void update( const Eigen::Vector3d& p, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, qt3d::vertex_buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
+    template < typename Buffer >
+    static void update( const Eigen::Vector3d& p, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, Buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
     {
         Eigen::Vector3d point = p - offset;
         buffer.addVertex( QVector3D( point.x(), point.y(), point.z() ), color, block );
@@ -64,7 +75,13 @@ struct Shapetraits< Eigen::Vector3d >
         }
     }
 
-    static void draw( QGLPainter* painter, unsigned int size, unsigned int index )
+    static void index( QArray< uint >&, unsigned int ) {}
+
+    static void instance( const Eigen::Vector3d&, const Eigen::Vector3d&, const QColor4ub&, unsigned int, qt3d::instance_buffer&, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& ) {}
+
+    static QVector3DArray outline() { return QVector3DArray(); }
+
+    static void draw( QGLPainter* painter, unsigned int size, unsigned int index, const QGLIndexBuffer* = NULL )
     {
         painter->draw( QGL::Points, size, index );
     }
@@ -78,7 +95,10 @@ template<>
 struct Shapetraits< snark::graphics::extents< Eigen::Vector3d > >
 {
     static const unsigned int size = 8;
-    static void update( const snark::graphics::extents< Eigen::Vector3d >& e, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, qt3d::vertex_buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
+    static const unsigned int indices = 24;
+    static const bool instanced = true;
+    template < typename Buffer >
+    static void update( const snark::graphics::extents< Eigen::Vector3d >& e, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, Buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
     {
         Eigen::Vector3f min = ( e.min() - offset ).cast< float >();
         Eigen::Vector3f max = ( e.max() - offset ).cast< float >();
@@ -98,24 +118,33 @@ struct Shapetraits< snark::graphics::extents< Eigen::Vector3d > >
         }
     }
 
-    static void draw( QGLPainter* painter, unsigned int size, unsigned int index )
+    static void index( QArray< uint >& indices, unsigned int first )
     {
-        const boost::array< unsigned short, 8  > baseIndices = { { 0, 4, 1, 5, 2, 6, 3, 7 } };
-        for( unsigned int i = 0; i < size; i += 8 )
-        {
-            // 2 line loops
-            painter->draw( QGL::LineLoop, 4, index + i );
-            painter->draw( QGL::LineLoop, 4, index + i + 4 );
+        static const uint edges[] = { 0, 1, 1, 2, 2, 3, 3, 0, 4, 5, 5, 6, 6, 7, 7, 4, 0, 4, 1, 5, 2, 6, 3, 7 }; // 2 faces and 4 lines between them
+        for( unsigned int i = 0; i < 24; ++i ) { indices.append( first + edges[i] ); }
+    }
 
-            // 4 lines
-            boost::array< unsigned short, 8  > lineIndices = baseIndices;
-            BOOST_FOREACH( unsigned short& j, lineIndices )
-            {
-                j += index + i;
-            }
-            painter->draw( QGL::Lines, &lineIndices[0], 8 );
+    static void instance( const snark::graphics::extents< Eigen::Vector3d >& e, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, qt3d::instance_buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents )
+    {
+        Eigen::Vector3f min = ( e.min() - offset ).cast< float >();
+        Eigen::Vector3f max = ( e.max() - offset ).cast< float >();
+        Eigen::Vector3f centre = ( min + max ) / 2;
+        Eigen::Vector3f size = max - min;
+        qt3d::shape_instance s = { { centre.x(), centre.y(), centre.z() }, { 0, 0, 0 }, { size.x(), size.y(), size.z() }, color };
+        buffer.add( s, block );
+        if( extents )
+        {
+            extents->add( min );
+            extents->add( max );
         }
     }
+
+    static QVector3DArray outline() { return qt3d::instanced_shapes::box(); }
+
+    static void draw( QGLPainter* painter, unsigned int size, unsigned int index, const QGLIndexBuffer* indices )
+    {
+        painter->draw( QGL::Lines, *indices, index / 8 * 24, size / 8 * 24 );
+    }
     
     static const Eigen::Vector3d& somePoint( const snark::graphics::extents< Eigen::Vector3d >& extents ) { return extents.min(); }
     
@@ -126,7 +155,10 @@ template<>
 struct Shapetraits< std::pair< Eigen::Vector3d, Eigen::Vector3d > >
 {
     static const unsigned int size = 2;
-    static void update( const std::pair< Eigen::Vector3d, Eigen::Vector3d >& p, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, qt3d::vertex_buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
+    static const unsigned int indices = 0;
+    static const bool instanced = false;
+    template < typename Buffer >
+    static void update( const std::pair< Eigen::Vector3d, Eigen::Vector3d >& p, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, Buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
     {
         Eigen::Vector3f first = ( p.first - offset ).cast< float >();
         Eigen::Vector3f second = ( p.second - offset ).cast< float >();
@@ -139,7 +171,13 @@ struct Shapetraits< std::pair< Eigen::Vector3d, Eigen::Vector3d > >
         }
     }
 
-    static void draw( QGLPainter* painter, unsigned int size, unsigned int index )
+    static void index( QArray< uint >&, unsigned int ) {}
+
+    static void instance( const std::pair< Eigen::Vector3d, Eigen::Vector3d >&, const Eigen::Vector3d&, const QColor4ub&, unsigned int, qt3d::instance_buffer&, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& ) {}
+
+    static QVector3DArray outline() { return QVector3DArray(); }
+
+    static void draw( QGLPainter* painter, unsigned int size, unsigned int index, const QGLIndexBuffer* = NULL )
     {
         painter->draw( QGL::Lines, size, index );
     }
@@ -162,7 +200,10 @@ template < std::size_t Size >
 struct Shapetraits< Ellipse< Size > >
 {
     static const unsigned int size = Size;
-    static void update( const Ellipse< Size >& ellipse, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, qt3d::vertex_buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
+    static const unsigned int indices = 2 * Size;
+    static const bool instanced = true;
+    template < typename Buffer >
+    static void update( const Ellipse< Size >& ellipse, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, Buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents  )
     {
         Eigen::Vector3d c = ellipse.centre - offset;
         const Eigen::Matrix3d& r = rotation_matrix::rotation( ellipse.orientation );
@@ -182,13 +223,32 @@ struct Shapetraits< Ellipse< Size > >
         }
     }
 
-    static void draw( QGLPainter* painter, unsigned int size, unsigned int index )
+    static void index( QArray< uint >& indices, unsigned int first )
     {
-        for( unsigned int i = 0; i < size; i += Size )
+        for( unsigned int i = 0; i < Size; ++i ) { indices.append( first + i ); indices.append( first + ( i + 1 ) % Size ); } // line loop as line pairs
+    }
+
+    static void instance( const Ellipse< Size >& ellipse, const Eigen::Vector3d& offset, const QColor4ub& color, unsigned int block, qt3d::instance_buffer& buffer, boost::optional< snark::graphics::extents< Eigen::Vector3f > >& extents )
+    {
+        Eigen::Vector3d centre = ellipse.centre - offset;
+        const Eigen::Vector3d& o = ellipse.orientation;
+        Eigen::Vector3f c = centre.cast< float >();
+        qt3d::shape_instance s = { { c.x(), c.y(), c.z() }, { float( o.x() ), float( o.y() ), float( o.z() ) }, { float( ellipse.major ), float( ellipse.minor ), 0 }, color };
+        buffer.add( s, block );
+        if( extents ) // quick and dirty: bounding cube of the ellipse, which is cheaper than its points
         {
-            painter->draw( QGL::LineLoop, Size, index + i );
+            float radius = std::max( std::abs( s.size[0] ), std::abs( s.size[1] ) );
+            extents->add( c - Eigen::Vector3f::Constant( radius ) );
+            extents->add( c + Eigen::Vector3f::Constant( radius ) );
         }
     }
+
+    static QVector3DArray outline() { return qt3d::instanced_shapes::ellipse( Size ); }
+
+    static void draw( QGLPainter* painter, unsigned int size, unsigned int index, const QGLIndexBuffer* indices )
+    {
+        painter->draw( QGL::Lines, *indices, index / Size * 2 * Size, size / Size * 2 * Size );
+    }
     
     static const Eigen::Vector3d& somePoint( const Ellipse< Size >& ellipse ) { return ellipse.centre; }
 
@@ -61,6 +61,15 @@ void Viewer::shutdown()
     for( unsigned int i = 0; i < readers.size(); ++i ) { readers[i]->shutdown(); }
 }
 
+void Viewer::recolor( const std::string& colour, const std::string& fields )
+{
+    std::vector< coloured* > c( readers.size(), NULL );
+    try { for( unsigned int i = 0; i < readers.size(); ++i ) { c[i] = colourFromString( colour, fields, m_background_color ); } } // all or nothing
+    catch( ... ) { for( unsigned int i = 0; i < c.size(); ++i ) { delete c[i]; } throw; }
+    for( unsigned int i = 0; i < readers.size(); ++i ) { readers[i]->recolor( c[i], m_offset ? *m_offset : Eigen::Vector3d( 0, 0, 0 ) ); }
+    update();
+}
+
 void Viewer::initializeGL( QGLPainter *painter )
 {
     (void) painter;
@@ -68,7 +77,11 @@ void Viewer::initializeGL( QGLPainter *painter )
 //     glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     qglClearColor( m_background_color.toColor() );
     if( m_cameraReader ) { m_cameraReader->start(); }
-    for( unsigned int i = 0; i < readers.size(); ++i ) { readers[i]->start(); }
+    for( unsigned int i = 0; i < readers.size(); ++i )
+    {
+        if( LabelAtlas::supported() ) { readers[i]->m_labelAtlas = &m_labelAtlas; }
+        readers[i]->start();
+    }
 }
 
 void Viewer::read()
@@ -137,6 +150,7 @@ void Viewer::paintGL( QGLPainter *painter )
         readers[i]->render( painter );
         if( readers[i]->pointSize > 1 ) { ::glDisable( GL_POINT_SMOOTH ); }
     }
+    m_labelAtlas.draw( painter );
         
     draw_coordinates( painter );
 }
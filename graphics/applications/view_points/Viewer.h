@@ -29,6 +29,8 @@
 #include <boost/thread.hpp>
 #include <snark/graphics/qt3d/view.h>
 #include "./CameraReader.h"
+#include "./Coloured.h"
+#include "./LabelAtlas.h"
 #include "./Reader.h"
 
 namespace snark { namespace graphics { namespace View {
@@ -45,6 +47,10 @@ public:
           );
     void shutdown();
 
+    /// colour all the readers with the colour map given as on the command line,
+    /// as if their fields were the given ones; throws, if colour map is invalid
+    void recolor( const std::string& colour, const std::string& fields );
+
 private slots:
     void read();
 
@@ -60,6 +66,7 @@ private:
     boost::optional< Eigen::Vector3d > m_cameraposition;
     boost::optional< Eigen::Vector3d > m_cameraorientation;
     bool m_cameraFixed;
+    LabelAtlas m_labelAtlas;
 };
 
 } } } // namespace snark { namespace graphics { namespace View {
@@ -0,0 +1,110 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_BLOCK_READER_HEADER_GUARD_
+#define SNARK_GRAPHICS_BLOCK_READER_HEADER_GUARD_
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <comma/base/exception.h>
+#include <comma/io/file_descriptor.h>
+#include <comma/io/select.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace snark { namespace graphics {
+
+/// read fixed-size records from a file descriptor, e.g. stdin or a pipe, in blocks of whatever is available,
+/// rather than a record at a time; a partial trailing record is kept for the next block
+class block_reader
+{
+public:
+    /// constructor
+    /// @param fd descriptor to read from
+    /// @param record_size record size in bytes
+    /// @param records maximum number of records in a block
+    block_reader( comma::io::file_descriptor fd, std::size_t record_size, std::size_t records );
+
+    /// wait up to timeout for at least one whole record, then take all the bytes available without waiting, up to a block
+    /// @return number of whole records at data(); 0, if timed out or at the end of stream
+    std::size_t read( const boost::posix_time::time_duration& timeout );
+
+    /// return records read by the last read()
+    const char* data() const { return &m_buffer[0]; }
+
+    /// return true, if the end of stream has been reached
+    bool eof() const { return m_eof; }
+
+private:
+    comma::io::file_descriptor m_fd;
+    std::size_t m_record_size;
+    std::vector< char > m_buffer;
+    std::size_t m_size; // bytes in buffer
+    std::size_t m_consumed; // bytes of whole records returned by the last read()
+    bool m_eof;
+    bool read_available_( const boost::posix_time::time_duration& timeout );
+};
+
+inline block_reader::block_reader( comma::io::file_descriptor fd, std::size_t record_size, std::size_t records )
+    : m_fd( fd )
+    , m_record_size( record_size )
+    , m_buffer( record_size * ( records == 0 ? 1 : records ) )
+    , m_size( 0 )
+    , m_consumed( 0 )
+    , m_eof( false )
+{
+}
+
+inline bool block_reader::read_available_( const boost::posix_time::time_duration& timeout ) // return false, if nothing was available
+{
+    comma::io::select select;
+    select.read().add( m_fd );
+    if( select.wait( timeout ) == 0 ) { return false; }
+    int n = ::read( m_fd, &m_buffer[ m_size ], m_buffer.size() - m_size );
+    if( n == 0 ) { m_eof = true; return false; }
+    if( n < 0 )
+    {
+        if( errno == EAGAIN || errno == EINTR ) { return false; }
+        COMMA_THROW( comma::exception, "failed to read: " << std::strerror( errno ) );
+    }
+    m_size += n;
+    return true;
+}
+
+inline std::size_t block_reader::read( const boost::posix_time::time_duration& timeout )
+{
+    m_size -= m_consumed;
+    std::memmove( &m_buffer[0], &m_buffer[ m_consumed ], m_size ); // partial record left from the last block
+    m_consumed = 0;
+    if( m_eof ) { return 0; }
+    if( m_size < m_record_size && !read_available_( timeout ) ) { return 0; }
+    while( m_size < m_buffer.size() && read_available_( boost::posix_time::time_duration() ) ); // take what else is there, do not sit on a partial block
+    if( m_size < m_record_size ) { return 0; }
+    std::size_t records = m_size / m_record_size;
+    m_consumed = records * m_record_size;
+    return records;
+}
+
+} } // namespace snark { namespace graphics {
+
+#endif // SNARK_GRAPHICS_BLOCK_READER_HEADER_GUARD_
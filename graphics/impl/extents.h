@@ -21,6 +21,7 @@
 
 #include <boost/array.hpp>
 #include <boost/optional.hpp>
+#include <Eigen/Core>
 #include <comma/math/compare.h>
 #include <comma/visiting/visit.h>
 
@@ -110,6 +111,11 @@ template < typename T, std::size_t Size > class extents_traits< boost::array< T,
         }
 };
 
+template < typename T, int Rows, int Options, int MaxRows, int MaxCols > struct extents_traits< Eigen::Matrix< T, Rows, 1, Options, MaxRows, MaxCols > > // fixed-size vectors, e.g. Eigen::Vector3f
+{
+    enum { size = Rows };
+};
+
 
 template < typename P >
 extents< P >::extents() : size_( 0 ) {}
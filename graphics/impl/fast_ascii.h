@@ -0,0 +1,146 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_FAST_ASCII_HEADER_GUARD_
+#define SNARK_GRAPHICS_FAST_ASCII_HEADER_GUARD_
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include <comma/base/exception.h>
+#include <comma/base/types.h>
+#include <comma/string/string.h>
+
+namespace snark { namespace graphics {
+
+/// parse decimal number, e.g. -12.345e-2, without iostreams, lexical_cast or locale
+/// exact for up to 15 significant digits and exponents up to 22; return false, if not a plain decimal number
+inline bool fast_parse( const char* begin, const char* end, double& d )
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    while( begin < end && *begin == ' ' ) { ++begin; }
+    while( begin < end && *( end - 1 ) == ' ' ) { --end; }
+    bool negative = false;
+    if( begin < end && ( *begin == '-' || *begin == '+' ) ) { negative = *begin++ == '-'; }
+    comma::uint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for( ; begin < end && *begin >= '0' && *begin <= '9'; ++begin, any = true )
+    {
+        if( digits < 19 ) { mantissa = mantissa * 10 + ( *begin - '0' ); if( mantissa > 0 ) { ++digits; } }
+        else { ++exponent; }
+    }
+    if( begin < end && *begin == '.' )
+    {
+        for( ++begin; begin < end && *begin >= '0' && *begin <= '9'; ++begin, any = true )
+        {
+            if( digits < 19 ) { mantissa = mantissa * 10 + ( *begin - '0' ); if( mantissa > 0 ) { ++digits; } --exponent; }
+        }
+    }
+    if( !any ) { return false; }
+    if( begin < end && ( *begin == 'e' || *begin == 'E' ) )
+    {
+        ++begin;
+        bool negativeExponent = false;
+        if( begin < end && ( *begin == '-' || *begin == '+' ) ) { negativeExponent = *begin++ == '-'; }
+        if( begin == end ) { return false; }
+        int e = 0;
+        for( ; begin < end && *begin >= '0' && *begin <= '9'; ++begin ) { if( e < 10000 ) { e = e * 10 + ( *begin - '0' ); } }
+        exponent += negativeExponent ? -e : e;
+    }
+    if( begin != end ) { return false; }
+    d = double( mantissa );
+    if( exponent < 0 ) { d = exponent >= -22 ? d / powers[ -exponent ] : d * std::pow( 10.0, exponent ); }
+    else if( exponent > 0 ) { d = exponent <= 22 ? d * powers[ exponent ] : d * std::pow( 10.0, exponent ); }
+    if( negative ) { d = -d; }
+    return true;
+}
+
+/// fast parser for delimited lines of numbers, mapping fields to value slots by name
+/// e.g. fields ",x,y,z,,id" and names "x,y,z,id": the second column goes to values[0], etc
+class fast_ascii
+{
+public:
+    /// constructor
+    /// @param names comma-separated slot names; a field matches a name, if it is equal to it or ends with "/" followed by it, e.g. "point/x"
+    fast_ascii( const std::string& fields, const std::string& names, char delimiter = ',' );
+
+    /// return true, if each non-empty field maps to a slot, i.e. no information would be lost
+    bool covers() const { return m_covers; }
+
+    /// return true, if a field for given slot is present
+    bool has( std::size_t slot ) const { return m_has[ slot ]; }
+
+    /// parse line into values; values for absent or empty fields are left unchanged
+    /// throw on malformed numbers or if the line is too short for a field that maps to a slot
+    void get( const char* begin, const char* end, double* values ) const;
+
+private:
+    std::vector< int > m_slots; // slot for each column, -1 if none
+    std::vector< bool > m_has;
+    std::size_t m_needed; // number of fields up to the last one that maps to a slot
+    char m_delimiter;
+    bool m_covers;
+};
+
+inline fast_ascii::fast_ascii( const std::string& fields, const std::string& names, char delimiter )
+    : m_needed( 0 )
+    , m_delimiter( delimiter )
+    , m_covers( true )
+{
+    std::vector< std::string > f = comma::split( fields, ',' );
+    std::vector< std::string > n = comma::split( names, ',' );
+    m_has.resize( n.size(), false );
+    m_slots.resize( f.size(), -1 );
+    for( std::size_t i = 0; i < f.size(); ++i )
+    {
+        for( std::size_t j = 0; j < n.size() && m_slots[i] < 0; ++j )
+        {
+            bool matches = f[i] == n[j] || ( f[i].size() > n[j].size() && f[i].compare( f[i].size() - n[j].size() - 1, std::string::npos, "/" + n[j] ) == 0 );
+            if( matches ) { m_slots[i] = j; m_has[j] = true; m_needed = i + 1; }
+        }
+        if( m_slots[i] < 0 && !f[i].empty() ) { m_covers = false; }
+    }
+}
+
+inline void fast_ascii::get( const char* begin, const char* end, double* values ) const
+{
+    const char* line = begin;
+    for( std::size_t i = 0; i < m_slots.size(); ++i )
+    {
+        if( begin > end )
+        {
+            if( i < m_needed ) { COMMA_THROW( comma::exception, "expected at least " << m_needed << " fields, got " << i << " in line \"" << std::string( line, end ) << "\"" ); }
+            return;
+        }
+        const char* e = begin;
+        while( e < end && *e != m_delimiter ) { ++e; }
+        if( m_slots[i] >= 0 && e > begin )
+        {
+            double& d = values[ m_slots[i] ];
+            if( !fast_parse( begin, e, d ) ) { d = boost::lexical_cast< double >( std::string( begin, e ) ); } // e.g. nan or inf
+        }
+        begin = e + 1;
+    }
+}
+
+} } // namespace snark { namespace graphics {
+
+#endif // SNARK_GRAPHICS_FAST_ASCII_HEADER_GUARD_
@@ -0,0 +1,140 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_MAPPED_FILE_HEADER_GUARD_
+#define SNARK_GRAPHICS_MAPPED_FILE_HEADER_GUARD_
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace snark { namespace graphics {
+
+/// memory-mapped file, e.g. to parse a large file in parallel chunks or to patch records in place
+class mapped_file
+{
+public:
+    /// chunk as begin and end pointers into the mapping
+    typedef std::pair< const char*, const char* > chunk;
+
+    /// return true, if the file is a non-empty regular file, i.e. not stdin, pipe, socket, etc
+    static bool mappable( const std::string& filename );
+
+    /// constructor, maps the whole file
+    /// @param writable if true, changes written to writable_data() go to the file
+    mapped_file( const std::string& filename, bool writable = false );
+
+    /// return beginning of the mapping
+    const char* data() const { return static_cast< const char* >( m_region.get_address() ); }
+
+    /// return beginning of the mapping for writing; only for writable mappings
+    char* writable_data() { return static_cast< char* >( m_region.get_address() ); }
+
+    /// write changes to the file now rather than when unmapped
+    void flush() { m_region.flush(); }
+
+    /// return file size
+    std::size_t size() const { return m_region.get_size(); }
+
+    /// split into at most n chunks of whole records of given size; a trailing partial record is left out
+    std::vector< chunk > chunks( std::size_t n, std::size_t record_size ) const;
+
+    /// split into at most n chunks of whole lines
+    std::vector< chunk > lines( std::size_t n ) const { return lines( data(), data() + size(), n ); }
+
+    /// split given range into at most n chunks of whole lines
+    static std::vector< chunk > lines( const char* begin, const char* end, std::size_t n );
+
+    /// get next line that is not blank into line, without line ending, and move begin past it; return false at end
+    static bool next_line( const char*& begin, const char* end, chunk& line );
+
+private:
+    boost::interprocess::file_mapping m_mapping;
+    boost::interprocess::mapped_region m_region;
+};
+
+inline bool mapped_file::mappable( const std::string& filename )
+{
+    boost::system::error_code error;
+    return boost::filesystem::is_regular_file( filename, error ) && boost::filesystem::file_size( filename, error ) > 0;
+}
+
+inline mapped_file::mapped_file( const std::string& filename, bool writable )
+    : m_mapping( filename.c_str(), writable ? boost::interprocess::read_write : boost::interprocess::read_only )
+    , m_region( m_mapping, writable ? boost::interprocess::read_write : boost::interprocess::read_only )
+{
+#ifndef WIN32
+    if( !writable ) { m_region.advise( boost::interprocess::mapped_region::advice_sequential ); } // writes are usually scattered
+#endif
+}
+
+inline std::vector< mapped_file::chunk > mapped_file::chunks( std::size_t n, std::size_t record_size ) const
+{
+    std::vector< chunk > v;
+    std::size_t records = size() / record_size;
+    if( n == 0 ) { n = 1; }
+    for( std::size_t i = 0, begin = 0; i < n && begin < records; ++i )
+    {
+        std::size_t end = records * ( i + 1 ) / n;
+        if( end == begin ) { continue; }
+        v.push_back( chunk( data() + begin * record_size, data() + end * record_size ) );
+        begin = end;
+    }
+    return v;
+}
+
+inline std::vector< mapped_file::chunk > mapped_file::lines( const char* begin, const char* end, std::size_t n )
+{
+    std::vector< chunk > v;
+    if( n == 0 ) { n = 1; }
+    while( begin < end )
+    {
+        const char* e = v.size() + 1 < n ? begin + ( end - begin ) / ( n - v.size() ) : end; // spread the rest evenly
+        if( e == begin ) { ++e; }
+        while( e < end && *( e - 1 ) != '\n' ) { ++e; } // move to the next line boundary
+        v.push_back( chunk( begin, e ) );
+        begin = e;
+    }
+    return v;
+}
+
+namespace impl {
+
+inline bool not_blank( char c ) { return c != ' ' && c != '\t'; }
+
+} // namespace impl {
+
+inline bool mapped_file::next_line( const char*& begin, const char* end, chunk& line )
+{
+    while( begin < end )
+    {
+        const char* e = std::find( begin, end, '\n' );
+        line = chunk( begin, e > begin && *( e - 1 ) == '\r' ? e - 1 : e );
+        begin = e == end ? end : e + 1;
+        if( std::find_if( line.first, line.second, impl::not_blank ) != line.second ) { return true; }
+    }
+    return false;
+}
+
+} } // namespace snark { namespace graphics {
+
+#endif // SNARK_GRAPHICS_MAPPED_FILE_HEADER_GUARD_
@@ -0,0 +1,161 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_PARALLEL_HEADER_GUARD_
+#define SNARK_GRAPHICS_PARALLEL_HEADER_GUARD_
+
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/thread.hpp>
+#include <comma/base/exception.h>
+
+namespace snark { namespace graphics {
+
+/// return number of threads to use for data-parallel work
+inline std::size_t parallel_threads()
+{
+    std::size_t n = boost::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+namespace impl {
+
+/// workers started once and reused for every parallel_for(), rather than a thread per call
+/// one job at a time: concurrent callers wait for each other; the caller works on its job, too
+class thread_pool
+{
+    public:
+        /// job: call( i ) for i in [0, size)
+        struct job
+        {
+            virtual ~job() {}
+            virtual void call( std::size_t i ) = 0;
+        };
+
+        thread_pool( std::size_t workers ) : m_job( NULL ), m_size( 0 ), m_next( 0 ), m_pending( 0 ), m_generation( 0 )
+        {
+            for( std::size_t i = 0; i < workers; ++i ) { boost::thread( boost::bind( &thread_pool::work_, this ) ).detach(); }
+        }
+
+        /// run job of given size; return once all its calls are done
+        void run( job& j, std::size_t size )
+        {
+            boost::mutex::scoped_lock run( m_run );
+            {
+                boost::mutex::scoped_lock lock( m_mutex );
+                m_job = &j;
+                m_size = size;
+                m_next = 0;
+                m_pending = size;
+                ++m_generation;
+            }
+            m_started.notify_all();
+            call_();
+            boost::mutex::scoped_lock lock( m_mutex );
+            while( m_pending > 0 ) { m_done.wait( lock ); }
+            m_job = NULL;
+        }
+
+        /// return pool of parallel_threads() - 1 workers, started on the first call; never destroyed
+        static thread_pool& instance()
+        {
+            static boost::once_flag once = BOOST_ONCE_INIT;
+            boost::call_once( once, &thread_pool::make_ );
+            return *instance_();
+        }
+
+    private:
+        boost::mutex m_run;
+        boost::mutex m_mutex;
+        boost::condition_variable m_started;
+        boost::condition_variable m_done;
+        job* m_job;
+        std::size_t m_size;
+        std::size_t m_next;
+        std::size_t m_pending;
+        std::size_t m_generation;
+
+        void work_()
+        {
+            for( std::size_t generation = 0; ; )
+            {
+                {
+                    boost::mutex::scoped_lock lock( m_mutex );
+                    while( m_generation == generation ) { m_started.wait( lock ); }
+                    generation = m_generation;
+                }
+                call_();
+            }
+        }
+
+        void call_() // take calls of the current job until there are none left
+        {
+            while( true )
+            {
+                job* j;
+                std::size_t i;
+                {
+                    boost::mutex::scoped_lock lock( m_mutex );
+                    if( m_next >= m_size ) { return; }
+                    j = m_job;
+                    i = m_next++;
+                }
+                j->call( i );
+                boost::mutex::scoped_lock lock( m_mutex );
+                if( --m_pending == 0 ) { m_done.notify_all(); }
+            }
+        }
+
+        static thread_pool*& instance_() { static thread_pool* pool = NULL; return pool; }
+        static void make_() { instance_() = new thread_pool( parallel_threads() - 1 ); } // quick and dirty: workers live as long as the process
+};
+
+template < typename F >
+struct parallel_job : public thread_pool::job
+{
+    const F& f;
+    std::vector< std::string > errors;
+    parallel_job( const F& f, std::size_t n ) : f( f ), errors( n ) {}
+    void call( std::size_t i )
+    {
+        try { f( i ); }
+        catch( std::exception& ex ) { errors[i] = ex.what(); }
+        catch( ... ) { errors[i] = "unknown exception"; }
+    }
+};
+
+} // namespace impl {
+
+/// call f( i ) for i from 0 to n - 1 on a pool of parallel_threads() threads, see impl::thread_pool; throw, if any of the calls threw
+/// f gets called concurrently, i.e. its operator() should be const; f must not call parallel_for() itself
+template < typename F >
+inline void parallel_for( std::size_t n, F f )
+{
+    if( n == 1 ) { f( 0 ); return; }
+    impl::parallel_job< F > job( f, n );
+    impl::thread_pool::instance().run( job, n );
+    for( std::size_t i = 0; i < n; ++i ) { if( !job.errors[i].empty() ) { COMMA_THROW( comma::exception, job.errors[i] ); } }
+}
+
+} } // namespace snark { namespace graphics {
+
+#endif // SNARK_GRAPHICS_PARALLEL_HEADER_GUARD_
@@ -0,0 +1,125 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <QGLContext>
+#include <QGLShaderProgram>
+#include "./instanced_shapes.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace snark { namespace graphics { namespace qt3d {
+
+typedef void ( APIENTRY *draw_arrays_instanced_function )( GLenum mode, GLint first, GLsizei count, GLsizei instances );
+typedef void ( APIENTRY *vertex_attrib_divisor_function )( GLuint index, GLuint divisor );
+
+static draw_arrays_instanced_function draw_arrays_instanced = NULL;
+static vertex_attrib_divisor_function vertex_attrib_divisor = NULL;
+
+static const char* vertexShader =
+    "attribute highp vec4 qt_Vertex;\n"
+    "attribute lowp vec4 qt_Color;\n"
+    "attribute highp vec4 qt_MultiTexCoord0;\n" // centre
+    "attribute highp vec4 qt_MultiTexCoord1;\n" // roll, pitch, yaw
+    "attribute highp vec4 qt_MultiTexCoord2;\n" // size
+    "uniform highp mat4 qt_ModelViewProjectionMatrix;\n"
+    "varying lowp vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    highp vec3 c = cos( qt_MultiTexCoord1.xyz );\n"
+    "    highp vec3 s = sin( qt_MultiTexCoord1.xyz );\n"
+    "    highp mat3 r = mat3( c.y * c.z, c.y * s.z, -s.y,\n" // by columns, same as rotation_matrix::rotation()
+    "                         -c.x * s.z + s.x * s.y * c.z, c.x * c.z + s.x * s.y * s.z, s.x * c.y,\n"
+    "                         s.x * s.z + c.x * s.y * c.z, -s.x * c.z + c.x * s.y * s.z, c.x * c.y );\n"
+    "    gl_Position = qt_ModelViewProjectionMatrix * vec4( r * ( qt_Vertex.xyz * qt_MultiTexCoord2.xyz ) + qt_MultiTexCoord0.xyz, 1.0 );\n"
+    "    color = qt_Color;\n"
+    "}\n";
+
+static const char* fragmentShader =
+    "varying lowp vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+instanced_shapes::instanced_shapes( const QVector3DArray& outline ) : m_outline( outline ) {}
+
+bool instanced_shapes::supported()
+{
+    static bool resolved = false; // quick and dirty: assume all gl contexts of the application are alike
+    if( resolved ) { return draw_arrays_instanced != NULL && vertex_attrib_divisor != NULL; }
+    resolved = true;
+    const QGLContext* context = QGLContext::currentContext();
+    if( context == NULL || !QGLShaderProgram::hasOpenGLShaderPrograms() ) { return false; }
+    draw_arrays_instanced = reinterpret_cast< draw_arrays_instanced_function >( context->getProcAddress( "glDrawArraysInstanced" ) );
+    if( draw_arrays_instanced == NULL ) { draw_arrays_instanced = reinterpret_cast< draw_arrays_instanced_function >( context->getProcAddress( "glDrawArraysInstancedARB" ) ); }
+    vertex_attrib_divisor = reinterpret_cast< vertex_attrib_divisor_function >( context->getProcAddress( "glVertexAttribDivisor" ) );
+    if( vertex_attrib_divisor == NULL ) { vertex_attrib_divisor = reinterpret_cast< vertex_attrib_divisor_function >( context->getProcAddress( "glVertexAttribDivisorARB" ) ); }
+    return draw_arrays_instanced != NULL && vertex_attrib_divisor != NULL;
+}
+
+QVector3DArray instanced_shapes::box()
+{
+    static const int corners[][3] = { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, 1 }, { 1, 1, 0 } };
+    static const unsigned int edges[] = { 0, 1, 1, 2, 2, 3, 3, 0, 4, 5, 5, 6, 6, 7, 7, 4, 0, 4, 1, 5, 2, 6, 3, 7 }; // 2 faces and 4 lines between them
+    QVector3DArray outline;
+    for( unsigned int i = 0; i < 24; ++i )
+    {
+        const int* c = corners[ edges[i] ];
+        outline.append( c[0] - 0.5f, c[1] - 0.5f, c[2] - 0.5f );
+    }
+    return outline;
+}
+
+QVector3DArray instanced_shapes::ellipse( unsigned int segments )
+{
+    const double step = 3.14159265358979323846l * 2 / segments;
+    QVector3DArray outline;
+    for( unsigned int i = 0; i < segments; ++i ) // line loop as line pairs
+    {
+        outline.append( std::cos( step * i ), std::sin( step * i ), 0 );
+        outline.append( std::cos( step * ( i + 1 ) ), std::sin( step * ( i + 1 ) ), 0 );
+    }
+    return outline;
+}
+
+void instanced_shapes::draw( QGLPainter* painter, instance_buffer& instances )
+{
+    if( instances.size() == 0 ) { return; }
+    if( !m_effect )
+    {
+        m_effect.reset( new QGLShaderProgramEffect );
+        m_effect->setVertexShader( vertexShader );
+        m_effect->setFragmentShader( fragmentShader );
+    }
+    static const GLuint attributes[] = { QGL::TextureCoord0, QGL::TextureCoord1, QGL::TextureCoord2, QGL::Color };
+    painter->setUserEffect( m_effect.get() );
+    painter->clearAttributes();
+    painter->setVertexAttribute( QGL::Position, m_outline ); // client-side array: set before the instance buffer gets bound
+    instances.bind( painter, instances.index() );
+    painter->update(); // matrices and effect, as painter->draw() would do
+    for( unsigned int i = 0; i < 4; ++i ) { vertex_attrib_divisor( attributes[i], 1 ); }
+    draw_arrays_instanced( GL_LINES, 0, m_outline.size(), instances.size() );
+    for( unsigned int i = 0; i < 4; ++i ) { vertex_attrib_divisor( attributes[i], 0 ); } // otherwise, other drawing with these attributes breaks
+    instances.release( painter );
+    painter->setUserEffect( NULL );
+}
+
+} } } // namespace snark { namespace graphics { namespace qt3d {
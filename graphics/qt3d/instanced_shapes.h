@@ -0,0 +1,62 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_QT3D_INSTANCED_SHAPES_H_
+#define SNARK_GRAPHICS_QT3D_INSTANCED_SHAPES_H_
+
+#include <boost/scoped_ptr.hpp>
+#include <Qt3D/qglpainter.h>
+#include <Qt3D/qglshaderprogrameffect.h>
+#include <Qt3D/qvector3darray.h>
+#include "./vertex_buffer.h"
+
+namespace snark { namespace graphics { namespace qt3d {
+
+/// shapes drawn as instances of an outline shared by all of them
+///
+/// the outline is drawn as lines once per instance in a single call; the vertex shader scales
+/// the outline by the instance size, rotates it by the instance roll, pitch, yaw (as rotation_matrix does)
+/// and moves it to the instance centre, i.e. only the instances get computed on cpu and uploaded
+///
+/// requires opengl 3.1 or ARB_instanced_arrays: check supported() and tessellate shapes on cpu otherwise
+class instanced_shapes
+{
+    public:
+        /// @param outline vertices drawn as line pairs
+        instanced_shapes( const QVector3DArray& outline );
+
+        /// return true, if instanced drawing is supported in the current gl context; call in gl context
+        static bool supported();
+
+        /// return edges of cube [-0.5, 0.5]^3 as 24 vertices, corners in the order extents shapes are tessellated in
+        static QVector3DArray box();
+
+        /// return unit circle in the xy plane as 2 * segments vertices
+        static QVector3DArray ellipse( unsigned int segments );
+
+        /// draw readable instances of the buffer; call in gl context
+        void draw( QGLPainter* painter, instance_buffer& instances );
+
+    private:
+        QVector3DArray m_outline;
+        boost::scoped_ptr< QGLShaderProgramEffect > m_effect;
+};
+
+} } } // namespace snark { namespace graphics { namespace qt3d {
+
+#endif /*SNARK_GRAPHICS_QT3D_INSTANCED_SHAPES_H_*/
@@ -0,0 +1,127 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <QGLContext>
+#include <QGLShaderProgram>
+#include "./pick_buffer.h"
+
+namespace snark { namespace graphics { namespace qt3d {
+
+static const char* vertexShader =
+    "#extension GL_EXT_gpu_shader4 : require\n"
+    "attribute highp vec4 qt_Vertex;\n"
+    "uniform highp mat4 qt_ModelViewProjectionMatrix;\n"
+    "uniform int base;\n"
+    "varying lowp vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = qt_ModelViewProjectionMatrix * qt_Vertex;\n"
+    "    unsigned int n = unsigned int( base ) + unsigned int( gl_VertexID ) + 1u;\n"
+    "    color = vec4( float( n & 255u ), float( ( n >> 8u ) & 255u ), float( ( n >> 16u ) & 255u ), float( n >> 24u ) ) / 255.0;\n"
+    "}\n";
+
+static const char* fragmentShader =
+    "varying lowp vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+pick_buffer::pick_buffer() : m_failed( false ) {}
+
+bool pick_buffer::supported()
+{
+    if( QGLContext::currentContext() == NULL || !QGLShaderProgram::hasOpenGLShaderPrograms() || !QGLFramebufferObject::hasOpenGLFramebufferObjects() ) { return false; }
+    const char* extensions = reinterpret_cast< const char* >( glGetString( GL_EXTENSIONS ) );
+    return extensions != NULL && std::strstr( extensions, "GL_EXT_gpu_shader4" ) != NULL;
+}
+
+void pick_buffer::begin( QGLPainter* painter, const QSize& size, const QGLCamera* camera )
+{
+    if( !m_framebuffer || m_framebuffer->size() != size )
+    {
+        m_surface.reset();
+        m_framebuffer.reset( new QGLFramebufferObject( size, QGLFramebufferObject::Depth, GL_TEXTURE_2D, GL_RGBA8 ) );
+        m_surface.reset( new QGLFramebufferObjectSurface( m_framebuffer.get() ) );
+    }
+    if( !m_effect )
+    {
+        m_effect.reset( new QGLShaderProgramEffect );
+        m_effect->setVertexShader( vertexShader );
+        m_effect->setFragmentShader( fragmentShader );
+    }
+    m_failed = false;
+    glGetFloatv( GL_COLOR_CLEAR_VALUE, m_clearColor );
+    m_blend = glIsEnabled( GL_BLEND );
+    m_dither = glIsEnabled( GL_DITHER );
+    painter->pushSurface( m_surface.get() );
+    painter->setCamera( camera ); // after the surface has been pushed, since the aspect ratio comes from it
+    glDisable( GL_BLEND );
+    glDisable( GL_DITHER );
+    glDisable( GL_POINT_SMOOTH );
+    glEnable( GL_DEPTH_TEST );
+    glClearColor( 0, 0, 0, 0 );
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    painter->setUserEffect( m_effect.get() );
+}
+
+void pick_buffer::draw( QGLPainter* painter, vertex_buffer& vertices, comma::uint32 base )
+{
+    if( m_failed || vertices.size() == 0 ) { return; }
+    painter->clearAttributes();
+    vertices.bind( painter );
+    painter->update(); // effect and matrices, as painter->draw() would do, for the program to be bound
+    if( m_effect->program() == NULL || !m_effect->program()->isLinked() ) { m_failed = true; vertices.release( painter ); return; }
+    m_effect->program()->setUniformValue( "base", GLint( base ) );
+    std::vector< vertex_buffer::interval > visible = vertices.visible( painter );
+    for( std::size_t i = 0; i < visible.size(); ++i ) { painter->draw( QGL::Points, visible[i].second - visible[i].first, visible[i].first ); } // gl_VertexID counts from first, i.e. it is the index in vertices()
+    vertices.release( painter );
+}
+
+std::vector< std::pair< QPoint, comma::uint32 > > pick_buffer::read( const QRect& rectangle ) const
+{
+    std::vector< std::pair< QPoint, comma::uint32 > > picked;
+    QRect r = rectangle.normalized() & QRect( QPoint( 0, 0 ), m_framebuffer->size() );
+    if( m_failed || r.isEmpty() ) { return picked; }
+    std::vector< unsigned char > pixels( r.width() * r.height() * 4 );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadPixels( r.left(), m_framebuffer->height() - 1 - r.bottom(), r.width(), r.height(), GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0] ); // one readback for the whole rectangle; rows come bottom up
+    for( int y = 0; y < r.height(); ++y )
+    {
+        for( int x = 0; x < r.width(); ++x )
+        {
+            const unsigned char* p = &pixels[ ( y * r.width() + x ) * 4 ];
+            comma::uint32 n = comma::uint32( p[0] ) | ( comma::uint32( p[1] ) << 8 ) | ( comma::uint32( p[2] ) << 16 ) | ( comma::uint32( p[3] ) << 24 );
+            if( n != 0 ) { picked.push_back( std::make_pair( QPoint( r.left() + x, r.bottom() - y ), n ) ); }
+        }
+    }
+    return picked;
+}
+
+bool pick_buffer::end( QGLPainter* painter )
+{
+    painter->setUserEffect( NULL );
+    painter->popSurface();
+    glClearColor( m_clearColor[0], m_clearColor[1], m_clearColor[2], m_clearColor[3] );
+    if( m_blend ) { glEnable( GL_BLEND ); }
+    if( m_dither ) { glEnable( GL_DITHER ); }
+    return !m_failed;
+}
+
+} } } // namespace snark { namespace graphics { namespace qt3d {
@@ -0,0 +1,77 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_QT3D_PICK_BUFFER_H_
+#define SNARK_GRAPHICS_QT3D_PICK_BUFFER_H_
+
+#include <utility>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <comma/base/types.h>
+#include <QGLFramebufferObject>
+#include <QRect>
+#include <Qt3D/qglcamera.h>
+#include <Qt3D/qglframebufferobjectsurface.h>
+#include <Qt3D/qglpainter.h>
+#include <Qt3D/qglshaderprogrameffect.h>
+#include "./vertex_buffer.h"
+
+namespace snark { namespace graphics { namespace qt3d {
+
+/// offscreen buffer for picking vertices on gpu
+///
+/// vertices get drawn with their number as colour, thus a click or a rectangle resolves to the vertices
+/// actually drawn there by reading back its pixels at once, rather than reading back depth and searching
+/// for points nearby on cpu; the number is base + index in vertices() + 1 packed into rgba, 0 for nothing,
+/// which is exact, since there is no blending, dithering or smoothing in the picking pass
+///
+/// the vertex shader takes the index from gl_VertexID, thus nothing gets uploaded for picking;
+/// requires framebuffer objects and EXT_gpu_shader4: check supported() and pick on cpu otherwise
+class pick_buffer
+{
+    public:
+        pick_buffer();
+
+        /// return true, if picking is supported in the current gl context; call in gl context
+        static bool supported();
+
+        /// start drawing into the offscreen buffer of the given size, e.g. of the widget, seen by the camera; call in gl context
+        void begin( QGLPainter* painter, const QSize& size, const QGLCamera* camera );
+
+        /// draw readable vertices of the buffer numbered from base + 1 on, where base is e.g. the number of vertices drawn before
+        void draw( QGLPainter* painter, vertex_buffer& vertices, comma::uint32 base );
+
+        /// return pixels in the rectangle (in widget coordinates) with vertices drawn on them and their numbers; call before end()
+        std::vector< std::pair< QPoint, comma::uint32 > > read( const QRect& rectangle ) const;
+
+        /// stop drawing into the offscreen buffer; return false, if picking failed, e.g. if the shader did not compile
+        bool end( QGLPainter* painter );
+
+    private:
+        boost::scoped_ptr< QGLFramebufferObject > m_framebuffer;
+        boost::scoped_ptr< QGLFramebufferObjectSurface > m_surface;
+        boost::scoped_ptr< QGLShaderProgramEffect > m_effect;
+        bool m_failed;
+        GLfloat m_clearColor[4]; // gl state to restore in end()
+        GLboolean m_blend;
+        GLboolean m_dither;
+};
+
+} } } // namespace snark { namespace graphics { namespace qt3d {
+
+#endif /*SNARK_GRAPHICS_QT3D_PICK_BUFFER_H_*/
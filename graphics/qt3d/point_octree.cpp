@@ -0,0 +1,187 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <QMatrix4x4>
+#include <Qt3D/qbox3d.h>
+#include "./point_octree.h"
+
+namespace snark { namespace graphics { namespace qt3d {
+
+namespace {
+
+enum { maxDepth = 21 }; // quick and dirty: stop splitting duplicate points somewhere
+
+float coordinate( const QVector3D& v, unsigned int axis ) { return axis == 0 ? v.x() : axis == 1 ? v.y() : v.z(); }
+
+template < typename V >
+void swap( V* vertices, unsigned int* indices, unsigned int i, unsigned int j ) // indices follow vertices, if any
+{
+    std::swap( vertices[i], vertices[j] );
+    if( indices ) { std::swap( indices[i], indices[j] ); }
+}
+
+template < typename V >
+unsigned int partition( V* vertices, unsigned int* indices, unsigned int begin, unsigned int end, unsigned int axis, float value ) // return index of first vertex not below value
+{
+    while( true )
+    {
+        while( begin < end && coordinate( vertex_traits< V >::position( vertices[begin] ), axis ) < value ) { ++begin; }
+        while( begin < end && !( coordinate( vertex_traits< V >::position( vertices[ end - 1 ] ), axis ) < value ) ) { --end; }
+        if( begin == end ) { return begin; }
+        swap( vertices, indices, begin++, --end );
+    }
+}
+
+typedef std::pair< float, int > Candidate; // projected radius in pixels, node index
+
+} // namespace {
+
+template < typename V >
+basic_point_octree< V >::basic_point_octree( QArray< V >& vertices, unsigned int capacity, std::vector< unsigned int >* permutation, const boost::atomic< bool >* cancel ):
+    m_capacity( capacity == 0 ? 1 : capacity ),
+    m_random( 88172645463325252ULL ),
+    m_cancel( cancel ),
+    m_cancelled( false )
+{
+    if( vertices.size() == 0 ) { return; }
+    QVector3D min = vertex_traits< V >::position( vertices[0] );
+    QVector3D max = min;
+    for( int i = 1; i < vertices.size(); ++i )
+    {
+        QVector3D p = vertex_traits< V >::position( vertices[i] );
+        min = QVector3D( std::min( min.x(), p.x() ), std::min( min.y(), p.y() ), std::min( min.z(), p.z() ) );
+        max = QVector3D( std::max( max.x(), p.x() ), std::max( max.y(), p.y() ), std::max( max.z(), p.z() ) );
+    }
+    QVector3D diagonal = max - min;
+    float halfSize = std::max( diagonal.x(), std::max( diagonal.y(), diagonal.z() ) ) / 2 + 0.001f;
+    if( permutation )
+    {
+        permutation->resize( vertices.size() );
+        for( unsigned int i = 0; i < permutation->size(); ++i ) { ( *permutation )[i] = i; }
+    }
+    build( vertices.data(), permutation ? &( *permutation )[0] : NULL, 0, vertices.size(), ( min + max ) / 2, halfSize, 0 );
+    if( m_cancelled ) { m_nodes.clear(); }
+}
+
+template < typename V >
+quint64 basic_point_octree< V >::random() // xorshift, good enough for subsampling
+{
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 7;
+    m_random ^= m_random << 17;
+    return m_random;
+}
+
+template < typename V >
+int basic_point_octree< V >::build( V* vertices, unsigned int* indices, unsigned int begin, unsigned int end, const QVector3D& centre, float halfSize, unsigned int depth )
+{
+    if( m_cancel && *m_cancel ) { m_cancelled = true; }
+    if( m_cancelled ) { return -1; }
+    int index = m_nodes.size();
+    unsigned int count = end - begin;
+    unsigned int own = count <= m_capacity || depth >= maxDepth ? count : m_capacity;
+    for( unsigned int i = 0; own < count && i < own; ++i ) { swap( vertices, indices, begin + i, begin + i + random() % ( count - i ) ); } // random subsample to the front
+    node n;
+    n.centre = centre;
+    n.halfSize = halfSize;
+    n.begin = begin;
+    n.end = begin + own;
+    std::fill( n.children, n.children + 8, -1 );
+    m_nodes.push_back( n );
+    if( own == count ) { return index; }
+    unsigned int bounds[9]; // octant o = 4 * x + 2 * y + z, where x, y, z are 1 for the upper half
+    bounds[0] = begin + own;
+    bounds[8] = end;
+    bounds[4] = partition( vertices, indices, bounds[0], bounds[8], 0, centre.x() );
+    for( unsigned int i = 0; i < 8; i += 4 ) { bounds[ i + 2 ] = partition( vertices, indices, bounds[i], bounds[ i + 4 ], 1, centre.y() ); }
+    for( unsigned int i = 0; i < 8; i += 2 ) { bounds[ i + 1 ] = partition( vertices, indices, bounds[i], bounds[ i + 2 ], 2, centre.z() ); }
+    float q = halfSize / 2;
+    for( unsigned int o = 0; o < 8; ++o )
+    {
+        if( bounds[o] == bounds[ o + 1 ] ) { continue; }
+        QVector3D c( centre.x() + ( o & 4 ? q : -q ), centre.y() + ( o & 2 ? q : -q ), centre.z() + ( o & 1 ? q : -q ) );
+        int child = build( vertices, indices, bounds[o], bounds[ o + 1 ], c, q, depth + 1 );
+        m_nodes[index].children[o] = child; // m_nodes may have been reallocated
+    }
+    return index;
+}
+
+template < typename V >
+bool basic_point_octree< V >::cullable( const QGLPainter* painter, const node& n )
+{
+    QVector3D h( n.halfSize, n.halfSize, n.halfSize );
+    return painter->isCullable( QBox3D( n.centre - h, n.centre + h ) );
+}
+
+template < typename V >
+std::size_t basic_point_octree< V >::draw( QGLPainter* painter, std::size_t budget, float pixels ) const
+{
+    if( m_nodes.empty() || cullable( painter, m_nodes[0] ) ) { return 0; }
+    const QMatrix4x4 modelview = painter->modelViewMatrix().top();
+    const QMatrix4x4 projection = painter->projectionMatrix().top();
+    GLint viewport[4];
+    ::glGetIntegerv( GL_VIEWPORT, viewport );
+    const float scale = QVector3D( modelview( 0, 0 ), modelview( 1, 0 ), modelview( 2, 0 ) ).length(); // modelview is a rotation, translation and uniform scaling
+    const float pixelsPerUnit = projection( 1, 1 ) * viewport[3] / 2;
+    std::vector< Candidate > queue;
+    std::vector< std::pair< unsigned int, unsigned int > > ranges;
+    queue.push_back( Candidate( std::numeric_limits< float >::max(), 0 ) );
+    std::size_t drawn = 0;
+    while( !queue.empty() )
+    {
+        std::pop_heap( queue.begin(), queue.end() );
+        Candidate candidate = queue.back();
+        queue.pop_back();
+        const node& n = m_nodes[ candidate.second ];
+        if( drawn + ( n.end - n.begin ) > budget ) { break; }
+        drawn += n.end - n.begin;
+        ranges.push_back( std::make_pair( n.begin, n.end ) );
+        if( candidate.first * 2 / std::sqrt( float( n.end - n.begin ) ) <= pixels ) { continue; } // fine enough
+        for( unsigned int o = 0; o < 8; ++o )
+        {
+            if( n.children[o] < 0 ) { continue; }
+            const node& child = m_nodes[ n.children[o] ];
+            if( cullable( painter, child ) ) { continue; }
+            QVector3D eye = modelview.map( child.centre );
+            float w = projection( 3, 0 ) * eye.x() + projection( 3, 1 ) * eye.y() + projection( 3, 2 ) * eye.z() + projection( 3, 3 ); // depth for perspective, 1 for orthographic projection
+            float radius = child.halfSize * std::sqrt( 3.0f ) * scale; // of the bounding sphere
+            float nearest = w + projection( 3, 2 ) * radius; // for perspective, projection( 3, 2 ) is -1: depth of the nearest point of the sphere
+            float projected = nearest > 0 ? radius * pixelsPerUnit / nearest : std::numeric_limits< float >::max(); // camera inside or behind the sphere: refine first
+            queue.push_back( Candidate( projected, n.children[o] ) );
+            std::push_heap( queue.begin(), queue.end() );
+        }
+    }
+    std::sort( ranges.begin(), ranges.end() );
+    for( unsigned int i = 0; i < ranges.size(); )
+    {
+        unsigned int j = i + 1;
+        while( j < ranges.size() && ranges[j].first == ranges[ j - 1 ].second ) { ++j; } // subtrees are contiguous, merge to draw in fewer calls
+        painter->draw( QGL::Points, ranges[ j - 1 ].second - ranges[i].first, ranges[i].first );
+        i = j;
+    }
+    return drawn;
+}
+
+template class basic_point_octree< packed_vertex >;
+template class basic_point_octree< quantised_vertex >;
+
+} } } // namespace snark { namespace graphics { namespace qt3d {
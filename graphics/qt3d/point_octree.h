@@ -0,0 +1,86 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_QT3D_POINT_OCTREE_H_
+#define SNARK_GRAPHICS_QT3D_POINT_OCTREE_H_
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <Qt3D/qarray.h>
+#include <Qt3D/qglpainter.h>
+#include <QVector3D>
+#include "./vertex_buffer.h"
+
+namespace snark { namespace graphics { namespace qt3d {
+
+/// level-of-detail octree over a static point cloud
+///
+/// building reorders the vertices, so that each node owns a contiguous range of them: a random subsample
+/// of the points in its cube that are not owned by its ancestors; therefore, a node together with its
+/// ancestors is an evenly thinned copy of the cloud in its cube, getting denser with each level
+///
+/// draw() walks the tree from the largest projected nodes to the smallest and refines nodes whose
+/// projected point spacing is still coarser than required, until the point budget is spent;
+/// nodes outside of the view frustum are skipped with all their descendants
+template < typename V >
+class basic_point_octree
+{
+    public:
+        /// build octree, reordering given vertices in place
+        /// @param capacity maximum number of vertices owned by a node
+        /// @param permutation if not NULL, filled with the original index of each reordered vertex; reordered along with the vertices
+        /// @param cancel if not NULL, building stops early once it is set, e.g. on shutdown; see cancelled()
+        basic_point_octree( QArray< V >& vertices, unsigned int capacity = 16384, std::vector< unsigned int >* permutation = NULL, const boost::atomic< bool >* cancel = NULL );
+
+        /// return true, if building has been cancelled; the octree and the order of vertices are unusable then
+        bool cancelled() const { return m_cancelled; }
+
+        /// draw selected nodes from the bound vertex buffer holding the reordered vertices; call in gl context
+        /// @param budget maximum number of points to draw
+        /// @param pixels point spacing on screen below which nodes do not get refined
+        /// @return number of points drawn
+        std::size_t draw( QGLPainter* painter, std::size_t budget, float pixels ) const;
+
+        /// return number of nodes
+        std::size_t size() const { return m_nodes.size(); }
+
+    private:
+        struct node
+        {
+            QVector3D centre;
+            float halfSize; // of the cube
+            unsigned int begin; // vertices owned by the node
+            unsigned int end;
+            int children[8]; // -1, if none
+        };
+        int build( V* vertices, unsigned int* indices, unsigned int begin, unsigned int end, const QVector3D& centre, float halfSize, unsigned int depth );
+        quint64 random();
+        static bool cullable( const QGLPainter* painter, const node& n );
+        std::vector< node > m_nodes;
+        const unsigned int m_capacity;
+        quint64 m_random;
+        const boost::atomic< bool >* m_cancel;
+        bool m_cancelled;
+};
+
+typedef basic_point_octree< packed_vertex > point_octree;
+typedef basic_point_octree< quantised_vertex > quantised_point_octree;
+
+} } } // namespace snark { namespace graphics { namespace qt3d {
+
+#endif /*SNARK_GRAPHICS_QT3D_POINT_OCTREE_H_*/
@@ -16,29 +16,69 @@
 // You should have received a copy of the GNU General Public
 // License along with snark. If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <boost/static_assert.hpp>
+#include <Qt3D/qbox3d.h>
 #include "./vertex_buffer.h"
 
 
 namespace snark { namespace graphics { namespace qt3d {
 
-vertex_buffer::vertex_buffer ( std::size_t size ):
+BOOST_STATIC_ASSERT( sizeof( packed_vertex ) == 16 );
+BOOST_STATIC_ASSERT( sizeof( quantised_vertex ) == 12 );
+BOOST_STATIC_ASSERT( sizeof( shape_instance ) == 40 );
+
+template < typename V >
+basic_vertex_buffer< V >::basic_vertex_buffer ( std::size_t size, bool blocks, float resolution ):
     m_readIndex( 0 ),
     m_writeIndex( 0 ),
     m_readSize( 0 ),
     m_writeSize( 0 ),
     m_bufferSize( size ),
-    m_block( 0 )
+    m_block( 0 ),
+    m_blocks( blocks ),
+    m_resolution( resolution ),
+    m_hasOrigin( false ),
+    m_widened( 0 ),
+    m_base( NULL ),
+    m_gpu( QGLBuffer::VertexBuffer ),
+    m_gpuSupported( true ),
+    m_gpuSize( 0 )
+{
+    m_vertices.resize( size );
+    m_chunks.resize( chunks() );
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::addVertex ( const QVector3D& point, const QColor4ub& color, unsigned int block )
+{
+    if( !m_hasOrigin ) { m_origin = point; m_hasOrigin = true; }
+    unsigned int i = next( block );
+    put( i, point, color );
+    updateChunk( i );
+    if( chunkComplete( i ) && !m_chunks[ chunkIndex( i ) ].wide.isEmpty() ) { narrow( i ); }
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::add( const V& vertex, unsigned int block )
 {
-    m_points.resize( 2 * size );
-    m_color.resize( 2 * size );
+    unsigned int i = next( block );
+    m_vertices[i] = vertex;
+    markDirty( i, i + 1 );
+    updateChunk( i );
 }
 
-void vertex_buffer::addVertex ( const QVector3D& point, const QColor4ub& color, unsigned int block )
+template < typename V >
+unsigned int basic_vertex_buffer< V >::next( unsigned int block ) // advance write position, return index of vertex to write
 {
-    if( block != m_block )
+    if( m_blocks && block != m_block )
     {
         m_block = block;
-
+        if( m_vertices.size() < int( 2 * m_bufferSize ) )
+        {
+            m_vertices.resize( 2 * m_bufferSize );
+            m_chunks.resize( 2 * chunks() );
+        }
         m_writeIndex += m_bufferSize;
         m_writeIndex %= 2 * m_bufferSize;
         if( m_readIndex == m_writeIndex )
@@ -49,40 +89,314 @@ void vertex_buffer::addVertex ( const QVector3D& point, const QColor4ub& color,
         }
         m_writeSize = 0;
     }
-    m_points[ m_writeIndex + m_writeSize ] = point;
-    m_color[ m_writeIndex + m_writeSize ] = color;
+    if( m_writeSize == m_bufferSize )
+    {
+        m_writeSize = 0;
+        m_readSize = m_bufferSize;
+    }
+    unsigned int i = m_writeIndex + m_writeSize;
+    if( i == chunkBegin( i ) ) // start overwriting chunk
+    {
+        chunk& c = m_chunks[ chunkIndex( i ) ];
+        if( i < m_readIndex || i >= m_readIndex + m_readSize ) { c = chunk(); } // its vertices are not drawn anymore, e.g. of a block before last, so it starts afresh with its own origin
+        else { c.previous = c.current; c.current = snark::graphics::extents< Eigen::Vector3f >(); }
+    }
     m_writeSize++;
-    if( block == 0 )
+    if( ( !m_blocks || block == 0 ) && m_readSize < m_bufferSize )
     {
         m_readSize++;
     }
-    if( m_writeSize > m_bufferSize )
+    return i;
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::put( unsigned int index, const QVector3D& point, const QColor4ub& color )
+{
+    chunk& c = m_chunks[ chunkIndex( index ) ];
+    if( !c.hasOrigin ) { c.origin = point; c.hasOrigin = true; }
+    if( c.wide.isEmpty() && !vertex_traits< V >::fits( point, c.origin, 1.0 / m_resolution ) ) { widen( index ); }
+    if( c.wide.isEmpty() )
+    {
+        vertex_traits< V >::set( m_vertices[index], point, color, c.origin, 1.0 / m_resolution );
+        markDirty( index, index + 1 );
+    }
+    else
     {
-        m_writeSize = 0;
-        m_readSize = m_bufferSize;
+        vertex_traits< packed_vertex >::set( c.wide[ index - chunkBegin( index ) ], point, color, QVector3D(), 1 );
+    }
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::widen( unsigned int index ) // copy the chunk into float vertices; only they are drawn for it, until it is complete and fits again
+{
+    chunk& c = m_chunks[ chunkIndex( index ) ];
+    const unsigned int begin = chunkBegin( index );
+    QArray< packed_vertex > wide;
+    wide.resize( chunkEnd( index ) - begin );
+    for( int i = 0; i < wide.size(); ++i )
+    {
+        const V& v = m_vertices[ begin + i ];
+        vertex_traits< packed_vertex >::set( wide[i], c.origin + vertex_traits< V >::position( v ) * m_resolution, v.color, QVector3D(), 1 );
+    }
+    c.wide = wide;
+    ++m_widened;
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::narrow( unsigned int index ) // quantise a complete chunk of float vertices again around the centre of its box, if they fit
+{
+    chunk& c = m_chunks[ chunkIndex( index ) ];
+    const QVector3D min( c.current.min().x(), c.current.min().y(), c.current.min().z() );
+    const QVector3D max( c.current.max().x(), c.current.max().y(), c.current.max().z() );
+    const QVector3D origin = ( min + max ) / 2;
+    if( !vertex_traits< V >::fits( min, origin, 1.0 / m_resolution ) || !vertex_traits< V >::fits( max, origin, 1.0 / m_resolution ) ) { return; }
+    const unsigned int begin = chunkBegin( index );
+    for( int i = 0; i < c.wide.size(); ++i ) { vertex_traits< V >::set( m_vertices[ begin + i ], vertex_traits< packed_vertex >::position( c.wide[i] ), c.wide[i].color, origin, 1.0 / m_resolution ); }
+    markDirty( begin, begin + c.wide.size() );
+    c.origin = origin;
+    c.wide = QArray< packed_vertex >();
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::assign( const QArray< V >& vertices )
+{
+    m_vertices = vertices;
+    m_bufferSize = m_vertices.size();
+    m_readIndex = 0;
+    m_writeIndex = 0;
+    m_readSize = m_bufferSize;
+    m_writeSize = m_bufferSize;
+    m_block = 0;
+    m_dirty[0] = range( 0, m_bufferSize );
+    m_dirty[1] = range();
+    m_chunks.clear();
+    m_chunks.resize( chunks() );
+    for( std::size_t i = 0; i < m_chunks.size(); ++i ) { m_chunks[i].origin = m_origin; m_chunks[i].hasOrigin = m_hasOrigin; }
+    for( unsigned int i = 0; i < m_bufferSize; ++i ) { updateChunk( i ); }
+}
+
+template < typename V >
+bool basic_vertex_buffer< V >::rebase()
+{
+    if( !vertex_traits< V >::quantised || m_readSize == 0 ) { return true; }
+    std::vector< std::pair< unsigned int, unsigned int > > ranges( 1, std::make_pair( m_readIndex, m_readIndex + m_readSize ) );
+    if( m_writeIndex != m_readIndex ) { ranges.push_back( std::make_pair( m_writeIndex, m_writeIndex + m_writeSize ) ); } // block being written
+    snark::graphics::extents< Eigen::Vector3f > box;
+    for( std::size_t r = 0; r < ranges.size(); ++r )
+    {
+        for( unsigned int i = ranges[r].first; i < ranges[r].second; i = chunkEnd( i ) )
+        {
+            const chunk& c = m_chunks[ chunkIndex( i ) ];
+            if( c.current.size() > 0 ) { box.add( c.current ); }
+            if( c.previous.size() > 0 ) { box.add( c.previous ); }
+        }
+    }
+    const QVector3D min( box.min().x(), box.min().y(), box.min().z() );
+    const QVector3D max( box.max().x(), box.max().y(), box.max().z() );
+    const QVector3D origin = ( min + max ) / 2;
+    if( !vertex_traits< V >::fits( min, origin, 1.0 / m_resolution ) || !vertex_traits< V >::fits( max, origin, 1.0 / m_resolution ) ) { return false; }
+    QArray< V > vertices = m_vertices; // quick and dirty: copy, since position() reads the old frame
+    for( std::size_t r = 0; r < ranges.size(); ++r )
+    {
+        for( unsigned int i = ranges[r].first; i < ranges[r].second; ++i ) { vertex_traits< V >::set( vertices[i], position( i ), color( i ), origin, 1.0 / m_resolution ); }
+    }
+    m_vertices = vertices;
+    for( std::size_t i = 0; i < m_chunks.size(); ++i )
+    {
+        m_chunks[i].origin = origin;
+        m_chunks[i].hasOrigin = true;
+        m_chunks[i].wide = QArray< packed_vertex >();
+    }
+    m_origin = origin;
+    markDirty( 0, m_vertices.size() );
+    return true;
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::updateChunk( unsigned int index )
+{
+    chunk& c = m_chunks[ chunkIndex( index ) ];
+    QVector3D p = position( index );
+    c.current.add( Eigen::Vector3f( p.x(), p.y(), p.z() ) );
+    if( chunkComplete( index ) ) { c.previous = snark::graphics::extents< Eigen::Vector3f >(); } // chunk or ring buffer complete
+}
+
+template < typename V >
+std::vector< typename basic_vertex_buffer< V >::interval > basic_vertex_buffer< V >::visible( const QGLPainter* painter, unsigned int shape ) const
+{
+    std::vector< interval > intervals;
+    const unsigned int end = m_readIndex + m_readSize;
+    for( unsigned int begin = m_readIndex; begin < end; )
+    {
+        const chunk& c = m_chunks[ chunkIndex( begin ) ];
+        const unsigned int last = std::min( chunkEnd( begin ), end );
+        snark::graphics::extents< Eigen::Vector3f > box = c.current;
+        if( c.previous.size() > 0 ) { box.add( c.previous ); }
+        QVector3D min( box.min().x(), box.min().y(), box.min().z() );
+        QVector3D max( box.max().x(), box.max().y(), box.max().z() );
+        if( vertex_traits< V >::quantised ) { min = ( min - m_origin ) / m_resolution; max = ( max - m_origin ) / m_resolution; } // painter is in the frame of bind()
+        bool outside = box.size() > 0 && painter->isCullable( QBox3D( min, max ) );
+        if( !outside )
+        {
+            unsigned int b = m_readIndex + ( begin - m_readIndex ) / shape * shape; // widen to whole shapes
+            unsigned int e = std::min( m_readIndex + ( last - m_readIndex + shape - 1 ) / shape * shape, end );
+            if( !vertex_traits< V >::quantised && !intervals.empty() && intervals.back().second >= b ) { intervals.back().second = std::max( intervals.back().second, e ); }
+            else { intervals.push_back( interval( b, e ) ); }
+        }
+        begin = last;
+    }
+    return intervals;
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::markDirty( unsigned int begin, unsigned int end )
+{
+    if( begin >= end ) { return; }
+    for( unsigned int i = 0; i < 2; ++i )
+    {
+        if( m_dirty[i].empty() ) { m_dirty[i] = range( begin, end ); return; }
+        if( begin <= m_dirty[i].end && end >= m_dirty[i].begin ) { m_dirty[i] = range( std::min( m_dirty[i].begin, begin ), std::max( m_dirty[i].end, end ) ); return; }
+    }
+    m_dirty[0] = range( std::min( begin, std::min( m_dirty[0].begin, m_dirty[1].begin ) ) // quick and dirty: should not happen for sequential writes
+                      , std::max( end, std::max( m_dirty[0].end, m_dirty[1].end ) ) );
+    m_dirty[1] = range();
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::erase( unsigned int i )
+{
+    unsigned int l = last();
+    if( i != l )
+    {
+        if( vertex_traits< V >::quantised ) { put( i, position( l ), color( l ) ); } // chunks of i and l may have different origins
+        else { m_vertices[i] = m_vertices[l]; markDirty( i, i + 1 ); }
+        QVector3D p = position( i );
+        m_chunks[ chunkIndex( i ) ].current.add( Eigen::Vector3f( p.x(), p.y(), p.z() ) ); // chunk box may only grow, still fine for culling
+    }
+    --m_writeSize;
+    --m_readSize;
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::upload()
+{
+    for( unsigned int i = 0; i < 2; ++i )
+    {
+        if( m_dirty[i].empty() ) { continue; }
+        m_gpu.write( m_dirty[i].begin * sizeof( V ), m_vertices.constData() + m_dirty[i].begin, ( m_dirty[i].end - m_dirty[i].begin ) * sizeof( V ) );
+        m_dirty[i] = range();
+    }
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::bind( QGLPainter* painter, unsigned int first )
+{
+    if( m_gpuSupported && !m_gpu.isCreated() )
+    {
+        m_gpuSupported = m_gpu.create(); // fails, if vertex buffer objects are not supported
+        if( m_gpuSupported ) { m_gpu.setUsagePattern( QGLBuffer::DynamicDraw ); }
+    }
+    if( m_gpuSupported && m_gpuSize != (unsigned int)( m_vertices.size() ) )
+    {
+        m_gpu.bind();
+        m_gpu.allocate( m_vertices.size() * sizeof( V ) );
+        if( m_gpuSize > 0 ) // second half has just been allocated, upload everything again
+        {
+            m_dirty[0] = range( 0, m_vertices.size() );
+            m_dirty[1] = range();
+        } // otherwise, what has been written so far is still in m_dirty
+        m_gpuSize = m_vertices.size();
+    }
+    const char* base = NULL; // offset into the bound vertex buffer object
+    if( m_gpuSupported )
+    {
+        m_gpu.bind();
+        upload();
+    }
+    else
+    {
+        base = reinterpret_cast< const char* >( m_vertices.constData() );
+    }
+    m_base = base + first * sizeof( V );
+    vertex_traits< V >::attributes( painter, m_base );
+    if( vertex_traits< V >::quantised )
+    {
+        painter->modelViewMatrix().push();
+        painter->modelViewMatrix().translate( m_origin );
+        painter->modelViewMatrix().scale( m_resolution );
+    }
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::release( QGLPainter* painter )
+{
+    if( vertex_traits< V >::quantised ) { painter->modelViewMatrix().pop(); }
+    if( m_gpuSupported ) { QGLBuffer::release( QGLBuffer::VertexBuffer ); }
+}
+
+template < typename V >
+void basic_vertex_buffer< V >::select( QGLPainter* painter, const interval& i )
+{
+    if( !vertex_traits< V >::quantised ) { return; }
+    const chunk& c = m_chunks[ chunkIndex( i.first ) ];
+    painter->modelViewMatrix().pop(); // replace frame of bind() or of the interval selected before
+    painter->modelViewMatrix().push();
+    if( c.wide.isEmpty() )
+    {
+        if( m_gpuSupported ) { m_gpu.bind(); }
+        vertex_traits< V >::attributes( painter, m_base );
+        painter->modelViewMatrix().translate( c.origin );
+        painter->modelViewMatrix().scale( m_resolution );
+    }
+    else
+    {
+        if( m_gpuSupported ) { QGLBuffer::release( QGLBuffer::VertexBuffer ); } // float vertices are client-side
+        std::size_t base = reinterpret_cast< std::size_t >( c.wide.constData() ) - chunkBegin( i.first ) * sizeof( packed_vertex ); // so that indices stay those of the whole buffer
+        vertex_traits< packed_vertex >::attributes( painter, reinterpret_cast< const char* >( base ) );
     }
 }
 
-const QVector3DArray& vertex_buffer::points() const
+template < typename V >
+QVector3D basic_vertex_buffer< V >::position( unsigned int i ) const
 {
-    return m_points;
+    const chunk& c = m_chunks[ chunkIndex( i ) ];
+    if( !c.wide.isEmpty() ) { return vertex_traits< packed_vertex >::position( c.wide[ i - chunkBegin( i ) ] ); }
+    QVector3D p = vertex_traits< V >::position( m_vertices[i] );
+    return vertex_traits< V >::quantised ? c.origin + p * m_resolution : p;
 }
 
-const QArray< QColor4ub >& vertex_buffer::color() const
+template < typename V >
+const QArray< V >& basic_vertex_buffer< V >::vertices() const
 {
-    return m_color;
+    return m_vertices;
 }
 
-const unsigned int vertex_buffer::size() const
+template < typename V >
+const unsigned int basic_vertex_buffer< V >::size() const
 {
     return m_readSize;
 }
 
-const unsigned int vertex_buffer::index() const
+template < typename V >
+const unsigned int basic_vertex_buffer< V >::index() const
 {
     return m_readIndex;
 }
 
+template class basic_vertex_buffer< packed_vertex >;
+template class basic_vertex_buffer< quantised_vertex >;
 
+// shape instances can only be added as they are: addVertex() and erase() are left out, since an instance cannot be made of a point
+template basic_vertex_buffer< shape_instance >::basic_vertex_buffer( std::size_t size, bool blocks, float resolution );
+template void basic_vertex_buffer< shape_instance >::add( const shape_instance& vertex, unsigned int block );
+template void basic_vertex_buffer< shape_instance >::assign( const QArray< shape_instance >& vertices );
+template void basic_vertex_buffer< shape_instance >::bind( QGLPainter* painter, unsigned int first );
+template void basic_vertex_buffer< shape_instance >::release( QGLPainter* painter );
+template std::vector< basic_vertex_buffer< shape_instance >::interval > basic_vertex_buffer< shape_instance >::visible( const QGLPainter* painter, unsigned int shape ) const;
+template const QArray< shape_instance >& basic_vertex_buffer< shape_instance >::vertices() const;
+template const unsigned int basic_vertex_buffer< shape_instance >::size() const;
+template const unsigned int basic_vertex_buffer< shape_instance >::index() const;
+template QVector3D basic_vertex_buffer< shape_instance >::position( unsigned int i ) const;
+template void basic_vertex_buffer< shape_instance >::markDirty( unsigned int begin, unsigned int end );
     
 } } } // namespace snark { namespace graphics { namespace qt3d {
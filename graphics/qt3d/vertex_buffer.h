@@ -19,35 +19,264 @@
 #ifndef SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_VERTEX_BUFFER_H_
 #define SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_VERTEX_BUFFER_H_
 
-#include <Qt3D/qvector3darray.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+#include <Qt3D/qarray.h>
 #include <Qt3D/qcolor4ub.h>
+#include <Qt3D/qglpainter.h>
+#include <QtOpenGL/qglbuffer.h>
+#include <QVector3D>
+#include <snark/graphics/impl/extents.h>
 
 namespace snark { namespace graphics { namespace qt3d {
 
-/// circular double buffer for vertices and color
-class vertex_buffer
+/// interleaved vertex: float position and colour, 16 bytes
+struct packed_vertex
+{
+    float x;
+    float y;
+    float z;
+    QColor4ub color;
+};
+
+/// interleaved vertex: position relative to origin of its chunk in units of buffer resolution and colour
+/// 12 bytes rather than 10 to keep colour 4-byte aligned
+struct quantised_vertex
+{
+    qint16 x;
+    qint16 y;
+    qint16 z;
+    qint16 padding;
+    QColor4ub color;
+};
+
+/// one shape drawn by instancing, 40 bytes: the vertex shader generates its outline
+/// for ellipses, size is major, minor, 0; for boxes, size is max - min
+struct shape_instance
+{
+    float centre[3];
+    float orientation[3]; // roll, pitch, yaw
+    float size[3];
+    QColor4ub color;
+};
+
+/// compile-time vertex layout as opengl sees it
+template < typename V > struct vertex_traits {};
+
+template <> struct vertex_traits< packed_vertex >
+{
+    enum { quantised = false };
+
+    static void attributes( QGLPainter* painter, const char* base )
+    {
+        painter->setVertexAttribute( QGL::Position, QGLAttributeValue( 3, GL_FLOAT, sizeof( packed_vertex ), base ) );
+        painter->setVertexAttribute( QGL::Color, QGLAttributeValue( 4, GL_UNSIGNED_BYTE, sizeof( packed_vertex ), base + 12 ) );
+    }
+
+    static void set( packed_vertex& v, const QVector3D& point, const QColor4ub& color, const QVector3D&, float )
+    {
+        v.x = point.x();
+        v.y = point.y();
+        v.z = point.z();
+        v.color = color;
+    }
+
+    static bool fits( const QVector3D&, const QVector3D&, float ) { return true; }
+
+    static QVector3D position( const packed_vertex& v ) { return QVector3D( v.x, v.y, v.z ); }
+};
+
+template <> struct vertex_traits< quantised_vertex >
+{
+    enum { quantised = true };
+
+    static void attributes( QGLPainter* painter, const char* base )
+    {
+        painter->setVertexAttribute( QGL::Position, QGLAttributeValue( 3, GL_SHORT, sizeof( quantised_vertex ), base ) );
+        painter->setVertexAttribute( QGL::Color, QGLAttributeValue( 4, GL_UNSIGNED_BYTE, sizeof( quantised_vertex ), base + 8 ) );
+    }
+
+    static void set( quantised_vertex& v, const QVector3D& point, const QColor4ub& color, const QVector3D& origin, float scale )
+    {
+        v.x = quantise( ( point.x() - origin.x() ) * scale );
+        v.y = quantise( ( point.y() - origin.y() ) * scale );
+        v.z = quantise( ( point.z() - origin.z() ) * scale );
+        v.color = color;
+    }
+
+    /// return true, if point is within 32767 steps of resolution from origin in each coordinate
+    static bool fits( const QVector3D& point, const QVector3D& origin, float scale )
+    {
+        QVector3D d = ( point - origin ) * scale;
+        return qAbs( d.x() ) < 32767.5 && qAbs( d.y() ) < 32767.5 && qAbs( d.z() ) < 32767.5;
+    }
+
+    static QVector3D position( const quantised_vertex& v ) { return QVector3D( v.x, v.y, v.z ); } // in units of resolution relative to origin
+
+    static qint16 quantise( float v ) { return qint16( qRound( v ) ); } // see fits()
+};
+
+/// shape instance attributes: centre, orientation and size in texture coordinates 0 to 2, see instanced_shapes
+template <> struct vertex_traits< shape_instance >
+{
+    enum { quantised = false };
+
+    static void attributes( QGLPainter* painter, const char* base )
+    {
+        painter->setVertexAttribute( QGL::TextureCoord0, QGLAttributeValue( 3, GL_FLOAT, sizeof( shape_instance ), base ) );
+        painter->setVertexAttribute( QGL::TextureCoord1, QGLAttributeValue( 3, GL_FLOAT, sizeof( shape_instance ), base + 12 ) );
+        painter->setVertexAttribute( QGL::TextureCoord2, QGLAttributeValue( 3, GL_FLOAT, sizeof( shape_instance ), base + 24 ) );
+        painter->setVertexAttribute( QGL::Color, QGLAttributeValue( 4, GL_UNSIGNED_BYTE, sizeof( shape_instance ), base + 36 ) );
+    }
+
+    static QVector3D position( const shape_instance& v ) { return QVector3D( v.centre[0], v.centre[1], v.centre[2] ); }
+};
+
+/// circular buffer for vertices and color
+/// if blocks are on, double buffer: the last complete block is shown while the next one is being written;
+/// the second half gets allocated only once the first block boundary is seen
+/// if supported, keeps a copy in a gpu vertex buffer object and uploads only what changed since the last bind()
+/// keeps bounding boxes of fixed-size chunks of vertices to skip chunks outside of the view frustum
+/// if quantised, each chunk has its own origin, the first vertex written into it; a chunk with a vertex that
+/// does not fit around its origin falls back to float vertices until it has been written over again, see select()
+template < typename V >
+class basic_vertex_buffer
 {
     public:
-        vertex_buffer( std::size_t size );
+        typedef V vertex_type;
+
+        /// vertices [first, second)
+        typedef std::pair< unsigned int, unsigned int > interval;
+
+        enum { chunk_size = 65536 };
+
+        /// @param blocks if false, block passed to addVertex() is ignored
+        /// @param resolution quantisation step, if V is quantised; the first vertex written into a chunk becomes its origin;
+        ///                   a vertex farther than 32767 steps from it makes only this chunk fall back to float vertices
+        basic_vertex_buffer( std::size_t size, bool blocks = false, float resolution = 0.001 );
 
+        /// not available for shape instances, use add()
         void addVertex( const QVector3D& point, const QColor4ub& color, unsigned int block = 0 );
 
-        const QVector3DArray& points() const;
-        const QArray<QColor4ub>& color() const;
+        /// add vertex as it is, e.g. a shape instance; not for quantised vertices, use addVertex()
+        void add( const V& vertex, unsigned int block = 0 );
+
+        /// replace contents with vertices in the same frame, e.g. reordered vertices() of this buffer after rebase(); blocks get reset
+        void assign( const QArray< V >& vertices );
+
+        /// quantise all the readable vertices around a single origin, e.g. to reorder them for level of detail; call once they are all added
+        /// vertices may move by up to half a step of resolution
+        /// @return false, if they do not fit around a single origin; the buffer is left as it is then
+        bool rebase();
+
+        /// set vertex attributes for drawing, upload changes to gpu, if needed; call in gl context
+        /// @param first vertex the attributes start at, e.g. for instanced drawing, which always starts at the first instance
+        void bind( QGLPainter* painter, unsigned int first = 0 );
+
+        /// release gpu buffer after drawing, otherwise client-side arrays drawn afterwards will be garbled
+        void release( QGLPainter* painter );
+
+        /// return readable vertices in chunks not entirely outside of the view frustum, adjacent ones merged,
+        /// unless quantised, since each chunk then is drawn in its own frame; call after bind()
+        /// @param shape number of vertices per shape, e.g. 2 for lines; intervals get widened to whole shapes
+        std::vector< interval > visible( const QGLPainter* painter, unsigned int shape = 1 ) const;
+
+        /// set up drawing of an interval returned by visible(), i.e. origin of its chunk or its float vertices; does nothing, unless quantised
+        void select( QGLPainter* painter, const interval& i );
+
+        /// return vertices; if quantised, relative to origins of their chunks, i.e. in the same frame only after rebase()
+        const QArray< V >& vertices() const;
         const unsigned int size() const;
         const unsigned int index() const;
 
+        /// return number of vertices allocated, i.e. twice capacity(), once the second half for blocks has been allocated
+        unsigned int allocated() const { return m_vertices.size(); }
+
+        /// return number of times a chunk has fallen back to float vertices, since a vertex did not fit around its origin
+        unsigned int widened() const { return m_widened; }
+
+        /// return index of the vertex added last
+        unsigned int last() const { return m_writeIndex + m_writeSize - 1; }
+
+        /// return position of i-th vertex as it was added, i.e. not quantised
+        QVector3D position( unsigned int i ) const;
+
+        /// return colour of i-th vertex
+        const QColor4ub& color( unsigned int i ) const { const chunk& c = m_chunks[ chunkIndex( i ) ]; return c.wide.isEmpty() ? m_vertices[i].color : c.wide[ i - chunkBegin( i ) ].color; }
+
+        /// make vertices exclusively owned by the buffer, i.e. not shared with copies of vertices(), so that setColor() does not copy them
+        void detach() { m_vertices.data(); for( std::size_t i = 0; i < m_chunks.size(); ++i ) { m_chunks[i].wide.data(); } } // non-const data() detaches
+
+        /// set colour of i-th vertex; may be called concurrently for distinct vertices after detach(); call markDirty() afterwards
+        void setColor( unsigned int i, const QColor4ub& color ) { chunk& c = m_chunks[ chunkIndex( i ) ]; if( c.wide.isEmpty() ) { m_vertices[i].color = color; } else { c.wide[ i - chunkBegin( i ) ].color = color; } }
+
+        /// upload vertices [begin, end) on the next bind()
+        void markDirty( unsigned int begin, unsigned int end );
+
+        /// return number of vertices the buffer holds before it starts overwriting the oldest ones
+        unsigned int capacity() const { return m_bufferSize; }
+
+        /// remove i-th vertex by moving the vertex added last into its place
+        /// only for buffers without blocks that have not been filled up
+        void erase( unsigned int i );
+
     protected:
-        QVector3DArray m_points;
-        QArray<QColor4ub> m_color;
+        QArray< V > m_vertices;
         unsigned int m_readIndex;
         unsigned int m_writeIndex;
         unsigned int m_readSize;
         unsigned int m_writeSize;
         unsigned int m_bufferSize;
         unsigned int m_block;
+        const bool m_blocks;
+        const float m_resolution;
+        QVector3D m_origin; // frame of bind(), i.e. the first vertex added or the common origin after rebase(); chunks get drawn in their own frames, see select()
+        bool m_hasOrigin;
+
+    private:
+        unsigned int m_widened;
+        const char* m_base; // vertex attributes set by bind()
+        unsigned int next( unsigned int block );
+        void put( unsigned int index, const QVector3D& point, const QColor4ub& color );
+        void widen( unsigned int index );
+        void narrow( unsigned int index );
+        struct range
+        {
+            unsigned int begin;
+            unsigned int end;
+            range( unsigned int begin = 0, unsigned int end = 0 ) : begin( begin ), end( end ) {}
+            bool empty() const { return begin == end; }
+        };
+        void upload();
+        QGLBuffer m_gpu;
+        bool m_gpuSupported;
+        unsigned int m_gpuSize;
+        range m_dirty[2]; // written since last upload; ring buffer wraparound or block switch results in at most two ranges
+        struct chunk
+        {
+            snark::graphics::extents< Eigen::Vector3f > current; // of vertices written since the chunk has been started again
+            snark::graphics::extents< Eigen::Vector3f > previous; // of vertices being overwritten, until the chunk is complete
+            QVector3D origin; // quantised vertices of the chunk are relative to it
+            bool hasOrigin;
+            QArray< packed_vertex > wide; // all the vertices of the chunk as floats, once a quantised vertex has not fitted around origin; empty otherwise
+            chunk() : hasOrigin( false ) {}
+        };
+        void updateChunk( unsigned int index );
+        unsigned int chunks() const { return ( m_bufferSize + chunk_size - 1 ) / chunk_size; } // per half
+        unsigned int halfBegin( unsigned int index ) const { return index < m_bufferSize ? 0 : m_bufferSize; }
+        unsigned int chunkIndex( unsigned int index ) const { return ( index < m_bufferSize ? 0 : chunks() ) + ( index - halfBegin( index ) ) / chunk_size; }
+        unsigned int chunkBegin( unsigned int index ) const { return halfBegin( index ) + ( index - halfBegin( index ) ) / chunk_size * chunk_size; }
+        unsigned int chunkEnd( unsigned int index ) const { return std::min< unsigned int >( chunkBegin( index ) + chunk_size, halfBegin( index ) + m_bufferSize ); }
+        bool chunkComplete( unsigned int index ) const { return index + 1 == chunkEnd( index ); }
+        std::vector< chunk > m_chunks; // boxes in world units, i.e. as vertices were added; with blocks, each half has its own chunks, since a block never spans both halves
 };
 
+typedef basic_vertex_buffer< packed_vertex > vertex_buffer;
+typedef basic_vertex_buffer< quantised_vertex > quantised_vertex_buffer;
+typedef basic_vertex_buffer< shape_instance > instance_buffer;
+
 } } } // namespace snark { namespace graphics { namespace qt3d {
 
 #endif /*SNARK_GRAPHICS_APPLICATIONS_VIEWPOINTS_VERTEX_BUFFER_H_*/
@@ -0,0 +1,240 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNARK_GRAPHICS_RING_BUFFER_HEADER_GUARD_
+#define SNARK_GRAPHICS_RING_BUFFER_HEADER_GUARD_
+
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <comma/base/exception.h>
+#include <comma/base/types.h>
+
+namespace snark { namespace graphics {
+
+namespace impl {
+
+/// keep a value on its own cache line to avoid false sharing between producer and consumer
+template < typename T >
+struct cache_line_padded
+{
+    enum { cache_line = 64 };
+    char before[ cache_line ];
+    T value;
+    char after[ cache_line ];
+};
+
+} // namespace impl {
+
+/// what to do if a ring buffer is full
+struct ring_buffer_policy
+{
+    enum values { drop_oldest, drop_newest, block };
+
+    /// return policy from string: "drop-oldest", "drop-newest" or "block"
+    static values from_string( const std::string& s )
+    {
+        if( s == "drop-oldest" ) { return drop_oldest; }
+        if( s == "drop-newest" ) { return drop_newest; }
+        if( s == "block" ) { return block; }
+        COMMA_THROW( comma::exception, "expected drop-oldest, drop-newest or block, got \"" << s << "\"" );
+    }
+};
+
+/// bounded lock-free single-producer/single-consumer ring buffer
+///
+/// producer: reserve() a slot, fill it, push() it; publish() makes all pushed elements
+///           visible to the consumer at once, i.e. a batch costs one hand-over
+/// consumer: claim() all published elements, read them with claimed( i ), release() them
+///
+/// if the ring is full, the producer drops the oldest unclaimed element, drops the new one
+/// or blocks until the consumer releases slots, depending on the policy
+///
+/// each slot has a sequence number telling whether it is free, published or claimed for a given position,
+/// so that the producer drops the oldest element with a single compare-and-swap on its slot, which only fails,
+/// if the consumer has just claimed it; claimed elements are never dropped: if the oldest element is claimed,
+/// the new one gets dropped instead, i.e. neither side ever waits for the other, unless the policy is block
+template < typename T >
+class ring_buffer
+{
+    public:
+        typedef ring_buffer_policy policy;
+
+        /// constructor; capacity gets rounded up to a power of 2
+        ring_buffer( std::size_t capacity, policy::values p = policy::drop_oldest );
+
+        /// producer: return slot for the next element; NULL, if the element has to be dropped or the ring is closed
+        T* reserve();
+
+        /// producer: commit the slot returned by reserve(), without making it visible to consumer yet
+        void push();
+
+        /// producer: make all pushed elements visible to consumer
+        void publish();
+
+        /// consumer: claim all published elements, return their number
+        std::size_t claim();
+
+        /// consumer: return i-th claimed element
+        const T& claimed( std::size_t i ) const { return m_slots[ ( m_claimBegin + i ) & m_mask ]; }
+
+        /// consumer: give claimed slots back to producer
+        void release();
+
+        /// wake up blocked producer and make reserve() return NULL from now on
+        void close() { m_closed = true; }
+
+        /// return number of dropped elements
+        comma::uint64 dropped() const { return m_dropped.value.load( boost::memory_order_relaxed ); }
+
+        /// return capacity
+        std::size_t capacity() const { return m_slots.size(); }
+
+        /// return number of published and not yet claimed or dropped elements (approximate, if called concurrently)
+        std::size_t size() const;
+
+        /// return true, if no elements are waiting to be claimed
+        bool empty() const { return size() == 0; }
+
+    private:
+        // sequence number of the slot for position p: p, if free to write p; p + 1, if p is published; p + 2, if p is claimed;
+        // p + capacity, once p is released or dropped, i.e. the slot is free to write the next position in it
+        enum { published = 1, claimed_ = 2 };
+        std::vector< T > m_slots;
+        boost::scoped_array< boost::atomic< std::size_t > > m_sequences;
+        const std::size_t m_mask;
+        const policy::values m_policy;
+        impl::cache_line_padded< boost::atomic< std::size_t > > m_head; // consumer: next position to claim, for size() only
+        impl::cache_line_padded< boost::atomic< std::size_t > > m_tail; // producer: end of published elements, for size() only
+        impl::cache_line_padded< boost::atomic< comma::uint64 > > m_dropped;
+        boost::atomic< bool > m_closed;
+        std::size_t m_pending; // producer only: end of pushed elements
+        std::size_t m_published; // producer only: end of published elements
+        std::size_t m_claimBegin; // consumer only
+        std::size_t m_claimEnd; // consumer only
+        boost::atomic< std::size_t >& sequence_( std::size_t position ) { return m_sequences[ position & m_mask ]; }
+        static std::size_t round_up_( std::size_t capacity );
+};
+
+template < typename T >
+inline std::size_t ring_buffer< T >::round_up_( std::size_t capacity )
+{
+    if( capacity == 0 ) { COMMA_THROW( comma::exception, "expected non-zero capacity" ); }
+    std::size_t c = 4; // at least as many as slot states
+    while( c < capacity ) { c <<= 1; }
+    return c;
+}
+
+template < typename T >
+inline ring_buffer< T >::ring_buffer( std::size_t capacity, policy::values p )
+    : m_slots( round_up_( capacity ) )
+    , m_sequences( new boost::atomic< std::size_t >[ m_slots.size() ] )
+    , m_mask( m_slots.size() - 1 )
+    , m_policy( p )
+    , m_closed( false )
+    , m_pending( 0 )
+    , m_published( 0 )
+    , m_claimBegin( 0 )
+    , m_claimEnd( 0 )
+{
+    for( std::size_t i = 0; i < m_slots.size(); ++i ) { m_sequences[i] = i; }
+    m_head.value = 0;
+    m_tail.value = 0;
+    m_dropped.value = 0;
+}
+
+template < typename T >
+inline T* ring_buffer< T >::reserve()
+{
+    while( !m_closed )
+    {
+        boost::atomic< std::size_t >& sequence = sequence_( m_pending );
+        std::size_t s = sequence.load( boost::memory_order_acquire );
+        if( s == m_pending ) { return &m_slots[ m_pending & m_mask ]; }
+        std::size_t oldest = m_pending - m_slots.size(); // element in the slot
+        if( s == oldest ) { publish(); continue; } // pushed, but not published yet, i.e. more than capacity elements pushed in a batch
+        switch( m_policy )
+        {
+            case policy::drop_newest:
+                m_dropped.value.fetch_add( 1, boost::memory_order_relaxed );
+                return NULL;
+            case policy::block:
+                boost::this_thread::sleep( boost::posix_time::milliseconds( 1 ) );
+                break;
+            case policy::drop_oldest:
+                m_dropped.value.fetch_add( 1, boost::memory_order_relaxed );
+                s = oldest + published;
+                if( sequence.compare_exchange_strong( s, m_pending, boost::memory_order_acq_rel ) ) { return &m_slots[ m_pending & m_mask ]; }
+                if( s == m_pending ) { m_dropped.value.fetch_sub( 1, boost::memory_order_relaxed ); return &m_slots[ m_pending & m_mask ]; } // consumer has just released it
+                return NULL; // consumer is reading the oldest element, drop the new one instead of waiting
+        }
+    }
+    return NULL;
+}
+
+template < typename T >
+inline void ring_buffer< T >::push() { ++m_pending; }
+
+template < typename T >
+inline void ring_buffer< T >::publish()
+{
+    for( ; m_published < m_pending; ++m_published ) { sequence_( m_published ).store( m_published + published, boost::memory_order_release ); }
+    m_tail.value.store( m_published, boost::memory_order_release );
+}
+
+template < typename T >
+inline std::size_t ring_buffer< T >::claim()
+{
+    std::size_t position = m_claimEnd;
+    while( true ) // skip elements dropped by producer; they are always the oldest
+    {
+        std::size_t s = sequence_( position ).load( boost::memory_order_acquire );
+        if( s - position < m_slots.size() ) { break; } // not dropped, i.e. free to write, published or (if wrapped around) dropped and rewritten
+        ++position;
+    }
+    m_claimBegin = position;
+    for( ; ; ++position )
+    {
+        std::size_t s = position + published;
+        if( !sequence_( position ).compare_exchange_strong( s, position + claimed_, boost::memory_order_acq_rel ) ) { break; } // not published yet or dropped by producer just now
+    }
+    m_claimEnd = position;
+    m_head.value.store( m_claimEnd, boost::memory_order_release );
+    return m_claimEnd - m_claimBegin;
+}
+
+template < typename T >
+inline void ring_buffer< T >::release()
+{
+    for( std::size_t position = m_claimBegin; position < m_claimEnd; ++position ) { sequence_( position ).store( position + m_slots.size(), boost::memory_order_release ); }
+    m_claimBegin = m_claimEnd;
+}
+
+template < typename T >
+inline std::size_t ring_buffer< T >::size() const
+{
+    std::size_t head = m_head.value.load( boost::memory_order_acquire );
+    std::size_t tail = m_tail.value.load( boost::memory_order_acquire );
+    return tail < head ? 0 : tail - head < m_slots.size() ? tail - head : m_slots.size();
+}
+
+} } // namespace snark { namespace graphics {
+
+#endif // SNARK_GRAPHICS_RING_BUFFER_HEADER_GUARD_
@@ -0,0 +1,128 @@
+// This file is part of snark, a generic and flexible library 
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License 
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <gtest/gtest.h>
+#include <comma/base/types.h>
+#include "../impl/block_reader.h"
+#include <unistd.h>
+
+namespace snark { namespace graphics {
+
+static const std::size_t record_size = 24; // e.g. x,y,z as 3d
+
+struct writer // write numbered records to a descriptor in pieces of given size, then close it
+{
+    int fd;
+    std::size_t count;
+    std::size_t piece;
+    void operator()() const
+    {
+        std::vector< char > buffer( count * record_size );
+        for( std::size_t i = 0; i < count; ++i ) { comma::uint64 n = i; std::memcpy( &buffer[ i * record_size ], &n, sizeof( n ) ); }
+        for( std::size_t i = 0; i < buffer.size(); )
+        {
+            std::size_t size = std::min( piece, buffer.size() - i );
+            int n = ::write( fd, &buffer[i], size );
+            if( n <= 0 ) { break; }
+            i += n;
+        }
+        ::close( fd );
+    }
+};
+
+static std::vector< std::size_t > read_all( block_reader& reader, std::size_t& bad ) // return block sizes; count records out of order
+{
+    std::vector< std::size_t > blocks;
+    comma::uint64 expected = 0;
+    while( !reader.eof() )
+    {
+        std::size_t count = reader.read( boost::posix_time::milliseconds( 100 ) );
+        if( count == 0 ) { continue; }
+        blocks.push_back( count );
+        for( std::size_t i = 0; i < count; ++i, ++expected )
+        {
+            comma::uint64 n;
+            std::memcpy( &n, reader.data() + i * record_size, sizeof( n ) );
+            if( n != expected ) { ++bad; }
+        }
+    }
+    return blocks;
+}
+
+TEST( block_reader, stdin_batches )
+{
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    int saved = ::dup( 0 );
+    ASSERT_EQ( 0, ::dup2( fds[0], 0 ) ); // records come through stdin, as for view-points reading a pipe
+    ::close( fds[0] );
+    writer w = { fds[1], 100000, 65536 };
+    boost::thread thread( w );
+    block_reader reader( 0, record_size, 4096 );
+    std::size_t bad = 0;
+    std::vector< std::size_t > blocks = read_all( reader, bad );
+    thread.join();
+    ::dup2( saved, 0 );
+    ::close( saved );
+    std::size_t total = 0;
+    for( std::size_t i = 0; i < blocks.size(); ++i ) { EXPECT_LE( blocks[i], 4096u ); total += blocks[i]; }
+    EXPECT_EQ( 100000u, total );
+    EXPECT_EQ( 0u, bad );
+    EXPECT_LT( blocks.size(), 100000u / 100 ); // hundreds of records per block rather than one
+}
+
+TEST( block_reader, partial_records )
+{
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    writer w = { fds[1], 1000, 7 }; // records split across writes
+    boost::thread thread( w );
+    block_reader reader( fds[0], record_size, 100 );
+    std::size_t bad = 0;
+    std::vector< std::size_t > blocks = read_all( reader, bad );
+    thread.join();
+    ::close( fds[0] );
+    std::size_t total = 0;
+    for( std::size_t i = 0; i < blocks.size(); ++i ) { EXPECT_LE( blocks[i], 100u ); total += blocks[i]; }
+    EXPECT_EQ( 1000u, total );
+    EXPECT_EQ( 0u, bad );
+}
+
+TEST( block_reader, timeout_and_eof )
+{
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    block_reader reader( fds[0], record_size, 10 );
+    EXPECT_EQ( 0u, reader.read( boost::posix_time::milliseconds( 10 ) ) ); // nothing written yet
+    EXPECT_FALSE( reader.eof() );
+    char half[ record_size / 2 ] = { 0 };
+    ASSERT_EQ( int( sizeof( half ) ), ::write( fds[1], half, sizeof( half ) ) );
+    EXPECT_EQ( 0u, reader.read( boost::posix_time::milliseconds( 10 ) ) ); // partial record is kept
+    ASSERT_EQ( int( sizeof( half ) ), ::write( fds[1], half, sizeof( half ) ) );
+    EXPECT_EQ( 1u, reader.read( boost::posix_time::milliseconds( 10 ) ) );
+    ::close( fds[1] );
+    while( !reader.eof() ) { EXPECT_EQ( 0u, reader.read( boost::posix_time::milliseconds( 10 ) ) ); }
+    ::close( fds[0] );
+}
+
+} } // namespace snark { namespace graphics {
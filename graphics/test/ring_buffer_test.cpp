@@ -0,0 +1,156 @@
+// This file is part of snark, a generic and flexible library
+// for robotics research.
+//
+// Copyright (C) 2011 The University of Sydney
+//
+// snark is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// snark is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with snark. If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <gtest/gtest.h>
+#include "../ring_buffer.h"
+
+namespace snark { namespace graphics {
+
+typedef ring_buffer< int > ring;
+
+static bool push( ring& r, int value ) // push and publish a single element; return false, if dropped
+{
+    int* slot = r.reserve();
+    if( slot == NULL ) { return false; }
+    *slot = value;
+    r.push();
+    r.publish();
+    return true;
+}
+
+static std::vector< int > take( ring& r ) // claim and release everything published
+{
+    std::vector< int > values( r.claim() );
+    for( std::size_t i = 0; i < values.size(); ++i ) { values[i] = r.claimed( i ); }
+    r.release();
+    return values;
+}
+
+static std::vector< int > range( int begin, int end )
+{
+    std::vector< int > values;
+    for( int i = begin; i < end; ++i ) { values.push_back( i ); }
+    return values;
+}
+
+struct producer // push one element into a full ring, blocking, if the policy says so
+{
+    ring* r;
+    boost::atomic< int >* state; // 0: not done yet; 1: pushed; 2: reserve() returned NULL
+    void operator()() const { *state = push( *r, 100 ) ? 1 : 2; }
+};
+
+TEST( ring_buffer, capacity )
+{
+    EXPECT_EQ( 4u, ring( 1 ).capacity() );
+    EXPECT_EQ( 8u, ring( 5 ).capacity() );
+    EXPECT_EQ( 8u, ring( 8 ).capacity() );
+}
+
+TEST( ring_buffer, wraparound )
+{
+    ring r( 4 );
+    for( int i = 0; i < 100; ++i ) // one element at a time, many times past capacity
+    {
+        ASSERT_TRUE( push( r, i ) );
+        EXPECT_EQ( 1u, r.size() );
+        EXPECT_EQ( std::vector< int >( 1, i ), take( r ) );
+        EXPECT_TRUE( r.empty() );
+    }
+    for( int i = 0; i < 99; i += 3 ) // batches of 3 straddling the end of the slots
+    {
+        for( int j = i; j < i + 3; ++j ) { int* slot = r.reserve(); ASSERT_TRUE( slot != NULL ); *slot = j; r.push(); }
+        EXPECT_TRUE( r.empty() ); // pushed, but not published yet
+        r.publish();
+        EXPECT_EQ( range( i, i + 3 ), take( r ) );
+    }
+    EXPECT_EQ( 0u, r.dropped() );
+}
+
+TEST( ring_buffer, drop_oldest )
+{
+    ring r( 8, ring::policy::drop_oldest );
+    for( int i = 0; i < 20; ++i ) { EXPECT_TRUE( push( r, i ) ); }
+    EXPECT_EQ( 8u, r.size() );
+    EXPECT_EQ( 12u, r.dropped() );
+    EXPECT_EQ( range( 12, 20 ), take( r ) ); // newest 8 in order
+    for( int i = 20; i < 23; ++i ) { EXPECT_TRUE( push( r, i ) ); } // ring is usable again afterwards
+    EXPECT_EQ( range( 20, 23 ), take( r ) );
+    EXPECT_EQ( 12u, r.dropped() );
+}
+
+TEST( ring_buffer, drop_oldest_claimed )
+{
+    ring r( 4, ring::policy::drop_oldest );
+    for( int i = 0; i < 4; ++i ) { EXPECT_TRUE( push( r, i ) ); }
+    EXPECT_EQ( 4u, r.claim() );
+    EXPECT_FALSE( push( r, 4 ) ); // claimed elements are never dropped, the new one is
+    EXPECT_EQ( 1u, r.dropped() );
+    r.release();
+    EXPECT_TRUE( push( r, 5 ) );
+    EXPECT_EQ( std::vector< int >( 1, 5 ), take( r ) );
+}
+
+TEST( ring_buffer, drop_newest )
+{
+    ring r( 8, ring::policy::drop_newest );
+    for( int i = 0; i < 8; ++i ) { EXPECT_TRUE( push( r, i ) ); }
+    for( int i = 8; i < 20; ++i ) { EXPECT_FALSE( push( r, i ) ); }
+    EXPECT_EQ( 12u, r.dropped() );
+    EXPECT_EQ( range( 0, 8 ), take( r ) ); // oldest 8 kept
+    EXPECT_TRUE( push( r, 20 ) );
+    EXPECT_EQ( std::vector< int >( 1, 20 ), take( r ) );
+}
+
+TEST( ring_buffer, block_wakes_on_consume )
+{
+    ring r( 4, ring::policy::block );
+    for( int i = 0; i < 4; ++i ) { EXPECT_TRUE( push( r, i ) ); }
+    boost::atomic< int > state( 0 );
+    producer p = { &r, &state };
+    boost::thread thread( p );
+    boost::this_thread::sleep( boost::posix_time::milliseconds( 50 ) );
+    EXPECT_EQ( 0, state ); // still waiting for a free slot
+    EXPECT_EQ( range( 0, 4 ), take( r ) );
+    thread.join();
+    EXPECT_EQ( 1, state );
+    EXPECT_EQ( std::vector< int >( 1, 100 ), take( r ) );
+    EXPECT_EQ( 0u, r.dropped() );
+}
+
+TEST( ring_buffer, close_releases_blocked_producer )
+{
+    ring r( 4, ring::policy::block );
+    for( int i = 0; i < 4; ++i ) { EXPECT_TRUE( push( r, i ) ); }
+    boost::atomic< int > state( 0 );
+    producer p = { &r, &state };
+    boost::thread thread( p );
+    boost::this_thread::sleep( boost::posix_time::milliseconds( 50 ) );
+    EXPECT_EQ( 0, state );
+    r.close();
+    thread.join();
+    EXPECT_EQ( 2, state );
+    EXPECT_TRUE( r.reserve() == NULL );
+    EXPECT_EQ( range( 0, 4 ), take( r ) ); // what has been published is still there
+}
+
+} } // namespace snark { namespace graphics {